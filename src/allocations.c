@@ -0,0 +1,78 @@
+#include "allocations.h"
+
+#ifdef VERIFIER_ALLOCATIONS
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t nb, size_t n);
+extern void *__libc_realloc(void *p, size_t n);
+
+static unsigned long allocations;
+static int allocations_verrou;
+
+/**
+ * Allocation après le démarrage: message (sans stdio, qui peut allouer) et abandon
+ */
+static void allocation_interdite(const char *fonction) {
+  static const char msg[] = "== ERROR: allocation dynamique après le démarrage: ";
+  
+  write(2, msg, sizeof(msg) - 1);
+  write(2, fonction, strlen(fonction));
+  write(2, "()\n", 3);
+  abort();
+}
+
+void *malloc(size_t n) {
+  __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&allocations_verrou, __ATOMIC_RELAXED)) {
+    allocation_interdite("malloc");
+  }
+  return __libc_malloc(n);
+}
+
+void *calloc(size_t nb, size_t n) {
+  __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&allocations_verrou, __ATOMIC_RELAXED)) {
+    allocation_interdite("calloc");
+  }
+  return __libc_calloc(nb, n);
+}
+
+void *realloc(void *p, size_t n) {
+  __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&allocations_verrou, __ATOMIC_RELAXED)) {
+    allocation_interdite("realloc");
+  }
+  return __libc_realloc(p, n);
+}
+
+#endif
+
+/**
+ * Nombre d'allocations depuis le lancement du processus
+ */
+unsigned long allocations_nombre() {
+#ifdef VERIFIER_ALLOCATIONS
+  return __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Fin du démarrage: toute allocation ultérieure avorte le processus
+ */
+void allocations_verrouiller() {
+#ifdef VERIFIER_ALLOCATIONS
+  __atomic_store_n(&allocations_verrou, 1, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Début de l'arrêt: les allocations sont de nouveau permises
+ * (pthread_cancel() charge par exemple libgcc_s à la demande)
+ */
+void allocations_deverrouiller() {
+#ifdef VERIFIER_ALLOCATIONS
+  __atomic_store_n(&allocations_verrou, 0, __ATOMIC_RELEASE);
+#endif
+}
@@ -0,0 +1,30 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+/*********************************************/
+/* Surveillance des allocations dynamiques   */
+/*********************************************/
+
+/**
+ * Compilé avec -DVERIFIER_ALLOCATIONS, malloc(), calloc() et realloc() sont
+ * interposés: chaque allocation est comptée et, une fois le démarrage terminé
+ * (allocations_verrouiller), toute allocation avorte le processus.
+ * Sans cette option les fonctions ne font rien.
+ */
+
+/**
+ * Nombre d'allocations depuis le lancement du processus
+ */
+unsigned long allocations_nombre();
+
+/**
+ * Fin du démarrage: toute allocation ultérieure avorte le processus
+ */
+void allocations_verrouiller();
+
+/**
+ * Début de l'arrêt: les allocations sont de nouveau permises
+ */
+void allocations_deverrouiller();
+
+#endif
@@ -11,38 +11,83 @@
 int main(int argc, char *argv[]) {
   int cadence = ANNEAU_CADENCE_DEFAULT; // Cadence définit en millisecondes
   
-  if (argc < 2) {
-    __raise(-1, "Usage: %s <projet [, cadence]>", argv[0]);
+  argc = lire_options_sortie(argc, argv);
+  argc = lire_option_entier(argc, argv, "--cases=", &nbCases);
+  argc = lire_option_entier(argc, argv, "--robots=", &nbRobots);
+  argc = lire_option_entier(argc, argv, "--anneau=", &numero);
+  argc = lire_option_chaine(argc, argv, "--recettes=", &fichierRecettes);
+  argc = lire_option_chaine(argc, argv, "--adaptative", &adaptative);
+  
+  // Robots sur les cases hors entrée et sortie du serveur
+  if (argc < 2 || (argc > 2 && (!lire_entier(argv[2], &cadence) || cadence < 0))
+    || nbCases < 2 || nbRobots < 1 || nbRobots > nbCases - 2 || numero < 0 || numero >= NB_ANNEAUX_MAX) {
+    __raise(-1, "Usage: %s <projet [, cadence | 0 = libre]> [--adaptative] [--cases=N] [--robots=1..N-2] [--anneau=0..%d] [--recettes=FICHIER] [--quiet | --log=binary | --log=trace]", argv[0], NB_ANNEAUX_MAX - 1);
   }
   
+  //
+  // Recettes: leur nombre fixe la taille du segment
+  nbProd = lire_recettes(fichierRecettes, recettes, plan);
+  
   //
   // Initialisation
   init(argv);
   
-  // Cadence
-  if (argc > 2) {
-    cadence = atoi(argv[2]);
-  }
-  
   // Anneau
   int i;
-  Anneau ano;
   
-  ano.id 	= __pid;
+  __anneau->id 		= __pid;
+  __anneau->numero 	= numero;
+  __anneau->nbCases 	= nbCases;
+  __anneau->nbRobots 	= nbRobots;
+  __anneau->nbProd 	= nbProd;
+  __anneau->taille 	= anneau_taille(nbCases, nbRobots, nbProd);
+  __anneau->tete 	= 0;
+  __anneau->generation 	= 0;
+  __anneau->libre 	= (cadence == ANNEAU_CADENCE_LIBRE);
+  __anneau->cadence 	= cadence;
+  __anneau->adaptative 	= (adaptative != NULL && !__anneau->libre);
+  __anneau->periode 	= cadence * 1000000ULL;
+  __anneau->acquitteServeur = 0;
+  __anneau->acquittements = 0;
   
-  for (i = 0; i < ANNEAU_NUM_CASES; i++) {
-    ano.cases[i].num 	= i;
-    ano.cases[i].type 	= VIDE;
-    ano.connexion[i] 	= 0;
+  anneau_geometrie();
+  anneau_recettes(recettes, plan);
+  controle_init();
+  
+  for (i = 0; i < nbCases; i++) {
+    __cases[i].num 	= i;
+    __cases[i].type 	= VIDE;
+    __connexions[i] 	= 0;
+  }
+  
+  for (i = 0; i < nbRobots; i++) {
+    __abonnes[i].pid 	= 0;
+    __abonnes[i].reveil = 0;
+    __abonnes[i].notifications = 0;
+    __abonnes[i].acquitte = 0;
+    __abonnes[i].marque = false;
   }
+  metriques_init();
   
-  *((Anneau *) __anneau) = ano;
+  journal_ouvrir(ACTEUR_ANNEAU);
     
   // 
   // Démarrage
   
-  printf("== Démarrage de l'anneau...\n");
-  printf("==== Cadence de rotation: %d ms/tour\n", cadence);
+  printf("== Démarrage de l'anneau %d...\n", numero);
+  if (__anneau->libre) {
+    printf("==== Rotation libre: dès que les abonnés ont traité la précédente\n");
+  } else if (__anneau->adaptative) {
+    printf("==== Cadence adaptative: période de %d ms/tour au plus, ajustée aux traitements\n", cadence);
+  } else {
+    printf("==== Cadence de rotation: %d ms/tour\n", cadence);
+  }
+  printf("==== %d cases, %d robots max, segment de %lu octets\n", nbCases, nbRobots, (unsigned long) __anneau->taille);
+  printf("==== %d produits (%s):", nbProd, fichierRecettes);
+  for (i = 0; i < nbProd; i++) {
+    printf(" P%d=%d", i + 1, plan[i]);
+  }
+  printf("\n");
   
   //
   info();
@@ -52,15 +97,32 @@ int main(int argc, char *argv[]) {
   usleep(2000);
   
   //
-  // Rotation
+  // En mode libre, rien ne sert de tourner avant que la ligne ne soit en place
+  if (__anneau->libre) {
+    attendre_ligne();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &debut);
+  
+  //
+  // Rotation: plus aucune allocation dynamique à partir d'ici
+  allocations_verrouiller();
+  
   int rotation = 1;
+  anneau_dates(0)->debut = horloge();
   while (1) {
-    usleep(cadence * 1000); // Attente
+    if (!__anneau->libre) {
+      cadencer(); // Attente
+    }
     
     // La roue tourne d'un pas
     tourner();
-    printf("\tRotation %5d: \n", rotation++);
-    info();
+    journal(EV_ROTATION, VIDE, 0, 0, __anneau->tete, 0, 0);
+    
+    if (__sortie == SORTIE_TEXTE) {
+      printf("\tRotation %5d: \n", rotation);
+      info();
+    }
+    rotation++;
     
     // Émission d'un signalS sonore pour informer les robots 
     ding();
@@ -74,15 +136,25 @@ int main(int argc, char *argv[]) {
  * Initialisation de l'anneau
  */
 void init(char** argv) {
+  key_t cle = anneau_cle(argv[1], numero);
+  
+  __pid = getpid();
+  
   printf("== Initialisation de l'anneau...\n");
   
   //
   // Mémoire partagée
   printf("==== Création de la mémoire partagée\n");
   
+  // Un segment laissé par une exécution précédente peut être d'une autre taille
+  if ((__shmid = shmget(cle, 0, 0666)) != -1) {
+    printf("====== Suppression du segment %d existant\n", __shmid);
+    shmctl(__shmid, IPC_RMID, NULL);
+  }
+  
   printf("====== Création du segment\n");
   
-  if ((__shmid = shmget(ftok(argv[1], ANNEAU_SHM_KEY), ANNEAU_SHM_SIZE, IPC_CREAT |  0666)) == -1) {
+  if ((__shmid = shmget(cle, anneau_taille(nbCases, nbRobots, nbProd), IPC_CREAT |  0666)) == -1) {
     __raise(-3, "======== ERROR: Impossible de créer le segment partagé.");
   }
   // Attachement à une adresse choisie par le système
@@ -95,7 +167,7 @@ void init(char** argv) {
   signal (SIGINT, callback_sigint);
   
   // Création du sémaphore
-  __semaphore = sem_open(SEM_NAME, O_CREAT, 0644, 1);
+  __semaphore = sem_open(anneau_nom_semaphore(numero), O_CREAT, 0644, 1);
   
   printf("==[ Utilisez Ctrl+C stopper l'anneau ]==\n\n");
 }
@@ -104,15 +176,17 @@ void init(char** argv) {
  * Fonction de rappel SIGINT
  */
 void callback_sigint (int s) {
+  allocations_deverrouiller();
+  
   printf("\n==== Réception du signal SIGINT");
   printf("\n====== Interuption du processus en cours...\n");
   
   // Stop connexions
   send_signal_to_connexions(SIGINT);
   int i;
-  for (i = 0; i < ANNEAU_NUM_CASES; i++) {
-    if (__anneau->connexion[i] != 0) {
-      waitpid(__anneau->connexion[i]);
+  for (i = 0; i < __anneau->nbCases; i++) {
+    if (__connexions[i] != 0) {
+      waitpid(__connexions[i]);
     }
   }
   
@@ -123,20 +197,60 @@ void callback_sigint (int s) {
     }
   }
   
-  // Suppression IPCs
-  msgctl(__shmid, IPC_RMID, NULL);
+  // Suppression IPCs: le segment disparaît au dernier détachement
+  shmctl(__shmid, IPC_RMID, NULL);
   
   // Suppression du sémaphore
   sem_post(__semaphore);
   sem_close(__semaphore);
-  sem_unlink(SEM_NAME);
+  sem_unlink(anneau_nom_semaphore(numero));
   
   printf("\n====== IPCs supprimés\n");
   
+  journal_fermer();
+  bilan();
+  latences_afficher(true);
+  
   __end_process();
   exit(0);
 }
 
+/**
+ * Attend que le serveur et les nbRobots robots soient connectés:
+ * la production démarre avec toute la ligne, d'une exécution à l'autre
+ */
+static void attendre_ligne() {
+  int i, n;
+  
+  printf("==== Attente du serveur et des %d robots...\n", __anneau->nbRobots);
+  
+  while (1) {
+    for (i = 0, n = 0; i < __anneau->nbRobots; i++) {
+      if (__abonnes[i].pid != 0) {
+	n++;
+      }
+    }
+    
+    if (__connexions[ANNEAU_POS_SERV_OUT] != 0 && n == __anneau->nbRobots) {
+      return;
+    }
+    usleep(1000);
+  }
+}
+
+/**
+ * Affiche le nombre de rotations et le débit depuis le démarrage
+ */
+static void bilan() {
+  struct timespec fin;
+  double duree;
+  
+  clock_gettime(CLOCK_MONOTONIC, &fin);
+  duree = (fin.tv_sec - debut.tv_sec) + (fin.tv_nsec - debut.tv_nsec) / 1e9;
+  
+  printf("====== Bilan: %u rotations en %.3f s, %.0f rotations/s\n", generation, duree, duree > 0 ? generation / duree : 0);
+}
+
 /**
  * Envoie le signal s aux processus connectés à l'anneau
  */
@@ -144,10 +258,12 @@ void send_signal_to_connexions(int s) {
   static int i;
   printf ("\n\tSIG(%d) sent to [ ", s);
   
-  for (i = 0; i < ANNEAU_NUM_CASES; i++) {
-    if (__anneau->connexion[i] != 0 && i != ANNEAU_POS_SERV_OUT) {
-      kill (__anneau->connexion[i], s);
-      printf("%d ", (int) __anneau->connexion[i]);
+  for (i = 0; i < __anneau->nbCases; i++) {
+    // Le serveur, branché à plusieurs positions, ne reçoit le signal qu'une fois: par son entrée
+    if (__connexions[i] != 0 && i != ANNEAU_POS_SERV_OUT
+	&& (i == ANNEAU_POS_SERV_IN || __connexions[i] != __connexions[ANNEAU_POS_SERV_IN])) {
+      kill (__connexions[i], s);
+      printf("%d ", (int) __connexions[i]);
     }
   }
   
@@ -157,34 +273,128 @@ void send_signal_to_connexions(int s) {
 
 /**
  * Envoie d'un signal sonore
+ * Les abonnés attendent sur le compteur de génération de l'anneau:
+ * les réveils futex remplacent l'envoi d'un SIGUSR1 par connexion
  */
 void ding() {
-  send_signal_to_connexions(SIGUSR1);
+  if (__anneau->libre) {
+    anneau_relayer_rotation(generation);
+  } else {
+    anneau_diffuser_rotation(generation);
+  }
 }
 
 /**
- * Permute le contenu de 2 cases
+ * Cadence fixe ou adaptative: attend que la rotation en cours soit acquittée par ses
+ * abonnés (barrière) et que sa période soit écoulée
+ * Un acquittement en retard retient l'anneau au plus ANNEAU_BARRIERE_MS de plus:
+ * la case ne quitte pas un robot qui la traite encore. Un robot qui manque aussi ce
+ * délai n'est plus attendu tant qu'il n'a pas rattrapé l'anneau: un robot gelé ou
+ * disparu ne retient qu'une rotation
  */
-void swap(Case *c1, Case *c2) {
-  static Case tmp;
-  tmp = *c1;
-  *c1 = *c2;
-  *c2 = tmp;
+static void cadencer() {
+  static unsigned long long echeance;
+  static struct timespec t;
+  static bool aTemps;
+  static int retards;
+  
+  echeance = anneau_dates(generation)->debut + __anneau->periode;
+  aTemps = anneau_barriere(generation, echeance);
+  
+  if (!aTemps && !anneau_barriere(generation, horloge() + ANNEAU_BARRIERE_MS * 1000000ULL)
+    && (retards = anneau_retarder(generation)) > 0) {
+    printf("====== Rotation %u: %d robot(s) sans acquittement depuis %d ms, plus attendus\n", generation, retards, ANNEAU_BARRIERE_MS);
+  }
+  
+  if (__anneau->adaptative) {
+    adapter(aTemps);
+  }
+  
+  // Reste de la période
+  if (aTemps) {
+    t.tv_sec  = echeance / 1000000000ULL;
+    t.tv_nsec = echeance % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+    }
+  }
+}
+
+/**
+ * Cadence adaptative: la période se rapproche de moitié, toutes les ADAPTATIVE_FENETRE
+ * rotations, du p99 de la durée des rotations (de l'anneau au dernier traitement) plus
+ * ADAPTATIVE_MARGE; elle double dès qu'un acquittement arrive après la période
+ * Bornée par ADAPTATIVE_MIN_US et par la cadence donnée
+ */
+static void adapter(bool aTemps) {
+  static Histogramme fenetre;
+  static unsigned long long cible, max;
+  static int n;
+  
+  max = __anneau->cadence * 1000000ULL;
+  
+  if (aTemps) {
+    latence_ajouter(&fenetre, __atomic_load_n(&anneau_dates(generation)->fin, __ATOMIC_ACQUIRE) - anneau_dates(generation)->debut);
+    if (++n < ADAPTATIVE_FENETRE) {
+      return;
+    }
+  
+    cible = latence_centile(&fenetre, 99) * ADAPTATIVE_MARGE;
+    if (cible < ADAPTATIVE_MIN_US * 1000ULL) {
+      cible = ADAPTATIVE_MIN_US * 1000ULL;
+    }
+    if (cible < __anneau->periode) {
+      __anneau->periode -= (__anneau->periode - cible) / 2;
+    } else {
+      __anneau->periode = cible < max ? cible : max;
+    }
+  } else {
+    // Recul: traitements plus longs que la période
+    __anneau->periode = __anneau->periode * 2 < max ? __anneau->periode * 2 : max;
+  }
+  
+  memset(&fenetre, 0, sizeof(Histogramme));
+  n = 0;
 }
 
 /**
  * Tourne l'anneau d'un pas
+ * La rotation de ANNEAU_RETARD_MESURE générations plus tôt est mesurée: les traitements
+ * achevés après la rotation suivante (rotation manquée par l'abonné) allongent sa durée
  */
 static void tourner() {
-  static Case c;
-  static int i;
+  static unsigned long long demande, pris, duree;
+  static DatesRotation *d;
+  static unsigned int r;
   
+  demande = horloge();
   sem_wait(__semaphore);
+  pris = horloge();
+  latence_ajouter(&__metriques->attenteAnneau, pris - demande);
+  
+  r = generation + 1 - ANNEAU_RETARD_MESURE;
+  if (generation + 1 > ANNEAU_RETARD_MESURE) {
+    d = anneau_dates(r);
+    duree = __atomic_load_n(&d->fin, __ATOMIC_ACQUIRE) - d->debut;
+    latence_ajouter(&__metriques->rotation, duree);
   
-  for (i = 0; i < (ANNEAU_NUM_CASES - 1); i++) {
-    swap(&((*((Anneau *) __anneau)).cases[i]), &((*((Anneau *) __anneau)).cases[i + 1]));
+    if (!__anneau->libre && duree > __anneau->periode) {
+      METRIQUE_AJOUTER(__metriques->depassements, 1);
+    }
   }
   
+  // Dates de la nouvelle rotation: la case des dates de la génération generation + 1 - ANNEAU_DATES, mesurée
+  d = anneau_dates(generation + 1);
+  d->debut = pris;
+  
+  // Le contenu de la position i+1 passe en position i: seule la tête avance
+  __anneau->tete = (__anneau->tete + 1) % __anneau->nbCases;
+  
+  // Sélection des robots concernés par la nouvelle case devant eux
+  __atomic_store_n(&d->diffusion, horloge(), __ATOMIC_RELEASE);
+  __atomic_store_n(&d->fin, d->diffusion, __ATOMIC_RELEASE);
+  generation = anneau_marquer_abonnes();
+  __atomic_store_n(&d->fin, horloge(), __ATOMIC_RELEASE);
+  
   sem_post(__semaphore);
 }
 
@@ -196,8 +406,8 @@ static void info() {
   static int i;
   
   // Affichage des éléments de l'anneau
-  for (i = 0; i < ANNEAU_NUM_CASES; i++) {
-    c = &((*((Anneau *) __anneau)).cases[i]);
+  for (i = 0; i < __anneau->nbCases; i++) {
+    c = anneau_case(i);
     
     printf ("\t\tPosition %2d: Case[%2d] : %s\n", i, c->num, desc_case(c));
   }
@@ -1,4 +1,5 @@
 ﻿#include "common.c"
+#include "journal.c"
 
 /**
  * Global vars: définis dans le fichier common.h
@@ -8,6 +9,19 @@
  * @var *__semaphore: Sémaphore de synchronisation de l'anneau
  */
 
+static unsigned int generation; // Génération de la dernière rotation
+static struct timespec debut;	// Début des rotations, pour le bilan
+
+static int nbCases  = ANNEAU_NUM_CASES; // Géométrie choisie au lancement (--cases, --robots)
+static int nbRobots = NB_ROBOTS;
+static int numero   = 0; // Numéro de l'anneau dans la ligne (--anneau): clé du segment et nom du sémaphore
+
+static char *adaptative = NULL; // --adaptative: la cadence donnée est la période maximale
+static char *fichierRecettes = RECETTES_FICHIER; // Recettes et plan de production (--recettes)
+static Produit recettes[NB_PROD_MAX];
+static int plan[NB_PROD_MAX];
+static int nbProd;
+
 /**
  * Initialisation de l'anneau
  */
@@ -18,20 +32,36 @@ void init(char** argv) ;
  */
 void callback_sigint (int s);
 
+/**
+ * Attend que le serveur et les nbRobots robots soient connectés
+ */
+static void attendre_ligne();
+
+/**
+ * Affiche le nombre de rotations et le débit depuis le démarrage
+ */
+static void bilan();
+
 /**
  * Envoie le signal s aux processus connectés à l'anneau
  */
 void send_signal_to_connexions(int s);
 
 /**
- * Lance un signal sonore
+ * Lance un signal sonore: diffusion de la rotation aux abonnés
  */
 void ding();
 
 /**
- * Permute le contenu de 2 cases
+ * Attend que la rotation en cours soit acquittée et que sa période soit écoulée
+ */
+static void cadencer();
+
+/**
+ * Cadence adaptative: ajuste la période aux durées des rotations
+ * aTemps: la rotation a été acquittée avant la fin de sa période
  */
-void swap(Case *c1, Case *c2);
+static void adapter(bool aTemps);
 
 /**
  * Tourne l'anneau d'un pas
@@ -0,0 +1,1860 @@
+#include "atelier.h"
+
+/**
+ * Global vars: définis dans le fichier common.h
+ * @var Produit *__produits		Recettes, par numéro de produit - 1
+ */
+
+/**
+ * Masque des numéros d'une liste: bit n - décalage pour le numéro n
+ */
+static unsigned int masque(const char *liste, int decalage) {
+  unsigned int m = 0;
+  int i;
+  
+  for (i = 0; liste[i]; i++) {
+    m |= 1u << (liste[i] - decalage);
+  }
+  return m;
+}
+
+/**
+ * Compile les capacités du robot: masques et table de décision des prises,
+ * évaluée à chaque rotation par une seule lecture
+ */
+static void poste_compiler(Poste *poste) {
+  Robot *bot = &poste->bot;
+  int m, i, op, sc, sp, nbComp;
+  unsigned char *d;
+  
+  poste->masqueOps = masque(bot->ops, 0);
+  poste->masqueProds[DEGRADE] = masque(bot->prodsDegrades, 1);
+  
+  // Produits: en mode normal, l'opération du rôle seulement (la première du robot par défaut)
+  poste->opsAcceptees[NORMAL]  = 1u << poste->op;
+  poste->opsAcceptees[DEGRADE] = poste->masqueOps;
+  
+  memset(poste->decision, 0, sizeof(poste->decision));
+  
+  for (m = DEGRADE; m <= NORMAL; m++) {
+    for (i = 0; i < __anneau->nbProd; i++) {
+      if (!((poste->masqueProds[m] >> i) & 1)) {
+	continue; // Je ne travaille pas sur ce produit
+      }
+      nbComp = __produits[i].nbComp;
+  
+      for (sc = 0; sc < NB_ETATS_STOCK / 2; sc++) {
+	for (sp = 0; sp < 2; sp++) {
+	  // Composant: de la place pour le stocker et, s'il complète le produit, pour stocker le produit
+	  // (sauf composants regroupés chez un autre robot par le serveur)
+	  if (sc < 3 && (sc != nbComp - 1 || sp == 0) && !((poste->composantsRefuses >> i) & 1)) {
+	    poste->decision[m][COMPOSANT - 1][i][0] |= 1 << (sc * 2 + sp);
+	  }
+  
+	  // Produit: de la place pour le stocker, et l'opération attendue
+	  if (sp == 0) {
+	    d = poste->decision[m][PRODUIT - 1][i];
+	    for (op = 1; op <= NB_OPS_MAX; op++) {
+	      if ((poste->opsAcceptees[m] >> op) & 1) {
+		d[op] |= 1 << (sc * 2 + sp);
+	      }
+	    }
+	  }
+	}
+      }
+    }
+  }
+}
+
+/**
+ * Initialise le poste d'un robot: stocks vides, mode NORMAL
+ * ops, prods et prodsDegrades sont des listes de numéros (voir lire_liste())
+ * Les recettes doivent être chargées: la table de décision en dépend
+ */
+void poste_init(Poste *poste, int id, char *ops, char *prods, char *prodsDegrades) {
+  int i;
+  
+  poste->bot.id   = id;
+  poste->bot.mode = NORMAL;
+  poste->bot.pos  = -1;
+  poste->bot.idx  = -1;
+  
+  if (lire_liste(ops, poste->bot.ops, sizeof(poste->bot.ops), NB_OPS_MAX, true) < 1
+    || lire_liste(prods, poste->bot.prods, sizeof(poste->bot.prods), NB_PROD_MAX, true) < 0
+    || lire_liste(prodsDegrades, poste->bot.prodsDegrades, sizeof(poste->bot.prodsDegrades), NB_PROD_MAX, true) < 0) {
+    __raise(-2, "Robot %d invalide: opérations 1..%d, produits 1..%d (ex: 125 ou 1,2,10)", id, NB_OPS_MAX, NB_PROD_MAX);
+  }
+  
+  for (i = 0; i < NB_PROD_MAX; i++) {
+    poste->bot.stockComposants[i] = 0;
+    poste->bot.stockProduits[i] = 0;
+  }
+  memset(poste->composants, 0, sizeof(poste->composants));
+  
+  poste->prochainePose = 0;
+  
+  poste->op = poste->bot.ops[0];
+  poste->masqueProds[NORMAL] = masque(poste->bot.prods, 1);
+  poste->composantsRefuses = 0;
+  poste_compiler(poste);
+}
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ * Une lecture de la table de décision: produit, état du stock local et mode
+ */
+bool puis_je_prendre_composant(Poste *poste, Case *c) {
+  static Robot *bot;
+  static int i;
+  
+  bot = &poste->bot;
+  i = c->c.num - 1;
+  
+  return (poste->decision[bot->mode][COMPOSANT - 1][i][0] >> ETAT_STOCK(bot, i)) & 1;
+}
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ * Une lecture de la table de décision: produit, opération attendue, état du stock local et mode
+ */
+bool puis_je_prendre_produit(Poste *poste, Case *c) {
+  static Robot *bot;
+  static int i;
+  
+  bot = &poste->bot;
+  
+  // Produit terminé: plus d'opération attendue
+  if (c->p.etat < 0) {
+    return false;
+  }
+  i = c->p.num - 1;
+  
+  return (poste->decision[bot->mode][PRODUIT - 1][i][(int) c->p.ops[c->p.etat]] >> ETAT_STOCK(bot, i)) & 1;
+}
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ */
+Composant prendre_composant(Case *c) {
+  static Composant composant;
+  
+  composant = c->c;
+  
+  metriques_case(c->type, VIDE);
+  c->type = VIDE;
+  c->c.num = 0;
+  
+  return composant;
+}
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ */
+Produit prendre_produit(Case *c) {
+  static Produit p;
+  
+  p = c->p;
+  
+  metriques_case(c->type, VIDE);
+  c->type = VIDE;
+  c->p.num = 0;
+  
+  return p;
+}
+
+/**
+ * Compte le motif du refus de la prise du contenu de la case c, dans l'ordre
+ * des conditions de poste_compiler(): hors du chemin des prises acceptées
+ */
+static void poste_refuser(Poste *poste, Case *c) {
+  static Robot *bot;
+  static MotifRefus motif;
+  static int i;
+  
+  bot = &poste->bot;
+  if (bot->idx < 0) {
+    return;
+  }
+  
+  if (c->type == PRODUIT && c->p.etat < 0) {
+    motif = REFUS_TERMINE;
+  } else {
+    i = (c->type == COMPOSANT ? c->c.num : c->p.num) - 1;
+  
+    if (!((poste->masqueProds[bot->mode] >> i) & 1)) {
+      motif = REFUS_PRODUIT;
+    } else if (c->type == COMPOSANT && ((poste->composantsRefuses >> i) & 1)) {
+      motif = REFUS_REGROUPE;
+    } else if (c->type == PRODUIT && !((poste->opsAcceptees[bot->mode] >> c->p.ops[c->p.etat]) & 1)) {
+      motif = REFUS_OPERATION;
+    } else {
+      motif = REFUS_STOCK;
+    }
+  }
+  
+  METRIQUE_AJOUTER(__metriquesRobots[bot->idx].refus[motif], 1);
+}
+
+/**
+ * Traitement par le robot de la case devant lui
+ * Appelée sémaphore pris dans le cas multi-processus
+ */
+Action poste_traiter(Poste *poste) {
+  static Action a;
+  static Robot *bot;
+  static Case *cur;
+  static Composant c;
+  static Produit p;
+  static int i;
+  
+  bot = &poste->bot;
+  cur = anneau_case(bot->pos);
+  a.type = ACTION_AUCUNE;
+  
+  switch (cur->type) {
+    case COMPOSANT:
+      if (puis_je_prendre_composant(poste, cur)) {
+	c = prendre_composant(cur);
+	journal(EV_PRISE, COMPOSANT, c.num, 0, bot->pos, 0, c.id);
+  
+	a.type = ACTION_PRISE_COMPOSANT;
+	a.c = c;
+  
+	i = c.num - 1;
+	p = __produits[i];
+  
+	poste->composants[i][bot->stockComposants[i]] = c;
+	bot->stockComposants[i]++;
+  
+	if (bot->stockComposants[i] == p.nbComp) {
+	  // Nombre de composants nécessaires atteint
+	  bot->stockComposants[i] = 0;
+	  memset(poste->composants[i], 0, sizeof(poste->composants[i]));
+	  p.id = c.id;
+	  p.injection = c.injection;
+	  journal(EV_ASSEMBLAGE, PRODUIT, p.num, 0, bot->pos, p.etat, p.id);
+  
+	  // Si je peux réaliser la première opération sur le produit
+	  if ((poste->masqueOps >> p.ops[p.etat]) & 1) {
+	    // J'effectue l'opération
+	    a.type = ACTION_ASSEMBLAGE;
+	    a.op = p.ops[p.etat];
+	    p.etat++; // Prochaine étape
+  
+	    if (p.etat == p.nbOps) {
+	      p.etat = -1; // Gamme d'une seule opération: produit terminé
+	    }
+	    journal(EV_OPERATION, PRODUIT, p.num, a.op, bot->pos, p.etat, p.id);
+	  } else {
+	    a.type = ACTION_INITIALISATION;
+	  }
+  
+	  bot->stockProduits[i]++;
+	  poste->produitsStock[i] = p;
+	  a.p = p;
+	}
+      } else {
+	poste_refuser(poste, cur);
+      }
+      break;
+  
+    case PRODUIT:
+      if (puis_je_prendre_produit(poste, cur)) {
+	// Je peux réaliser l'opération p.ops[p.etat] nécessaire
+	p = prendre_produit(cur); // Je prends le produit
+	journal(EV_PRISE, PRODUIT, p.num, p.ops[p.etat], bot->pos, p.etat, p.id);
+  
+	a.type = ACTION_OPERATION;
+	a.pris = p;
+	a.op = p.ops[p.etat];
+  
+	// J'effectue l'opération
+	p.etat++; // Prochaine opération
+  
+	if (p.etat == p.nbOps) {
+	  p.etat = -1; // Produit terminée
+	}
+	journal(EV_OPERATION, PRODUIT, p.num, a.op, bot->pos, p.etat, p.id);
+  
+	i = p.num - 1;
+  
+	poste->produitsStock[i] = p;
+	bot->stockProduits[i]++;
+	a.p = p;
+      } else {
+	poste_refuser(poste, cur);
+      }
+      break;
+  
+    case VIDE:
+      // Composants incomplets remis sur l'anneau quand il est vide, ou dès la première case
+      // vide s'ils sont regroupés chez un autre robot par le serveur
+      if (nb_cases_vides() == __anneau->nbCases || poste->composantsRefuses) {
+	for (i = 0; i < __anneau->nbProd; i++) {
+	  if ((nb_cases_vides() == __anneau->nbCases || ((poste->composantsRefuses >> i) & 1))
+	      && ((bot->stockComposants[i] == 1 && __produits[i].nbComp > 1) || (bot->stockComposants[i] == 2 && __produits[i].nbComp == 3))) {
+	    // Je remets sur l'anneau le dernier composant i reçu, retiré du stock
+	    bot->stockComposants[i]--;
+	    cur->c = poste->composants[i][bot->stockComposants[i]];
+	    poste->composants[i][bot->stockComposants[i]].id = 0;
+	    cur->type = COMPOSANT;
+	    metriques_case(VIDE, COMPOSANT);
+	    journal(EV_POSE, COMPOSANT, i + 1, 0, bot->pos, 0, cur->c.id);
+  
+	    a.type = ACTION_POSE_COMPOSANT;
+	    a.c = cur->c;
+	    break;
+	  }
+	}
+      }
+  
+      if (cur->type == VIDE) {
+	while (poste->prochainePose < __anneau->nbProd) {
+	  if (bot->stockProduits[poste->prochainePose] == 1) {
+	    // je pose le produit prochainePose sur la case
+	    p = poste->produitsStock[poste->prochainePose];
+  
+	    cur->p = p;
+	    cur->type = PRODUIT;
+	    metriques_case(VIDE, PRODUIT);
+	    journal(EV_POSE, PRODUIT, p.num, (p.etat == -1 ? 0 : p.ops[p.etat]), bot->pos, p.etat, p.id);
+  
+	    bot->stockProduits[poste->prochainePose] = 0;
+  
+	    a.type = ACTION_POSE_PRODUIT;
+	    a.p = p;
+  
+	    poste->prochainePose++;
+	    break;
+	  }
+	  poste->prochainePose++;
+	}
+  
+	if (poste->prochainePose >= __anneau->nbProd) {
+	  poste->prochainePose = 0;
+	}
+      }
+      break;
+  }
+  
+  // Utilisation du robot, pour le pilotage des rôles
+  if (a.type != ACTION_AUCUNE && bot->idx >= 0) {
+    __abonnes[bot->idx].actions++;
+  }
+  
+  if (bot->idx >= 0 && a.type != ACTION_AUCUNE) {
+    METRIQUE_AJOUTER(__metriquesRobots[bot->idx].occupe, 1);
+  } else if (bot->idx >= 0) {
+    METRIQUE_AJOUTER(__metriquesRobots[bot->idx].bloque, 1);
+  }
+  
+  return a;
+}
+
+/**
+ * Calcule les contenus de case sur lesquels le robot peut agir
+ * Lit la même table de décision que puis_je_prendre_composant() et
+ * puis_je_prendre_produit(), et reprend les conditions de la pose sur une case VIDE
+ */
+void poste_interet(Poste *poste, Interet *it) {
+  static Robot *bot;
+  static int i, s;
+  
+  bot = &poste->bot;
+  
+  it->vide = (poste->prochainePose != 0);
+  it->composants = 0;
+  
+  for (i = 0; i < __anneau->nbProd; i++) {
+    // Stock à poser: produit prêt ou composant à remettre sur l'anneau
+    if (bot->stockProduits[i] == 1
+      || (bot->stockComposants[i] == 1 && __produits[i].nbComp > 1)
+      || (bot->stockComposants[i] == 2 && __produits[i].nbComp == 3)) {
+      it->vide = true;
+    }
+  
+    s = ETAT_STOCK(bot, i);
+  
+    // Composants
+    if ((poste->decision[bot->mode][COMPOSANT - 1][i][0] >> s) & 1) {
+      it->composants |= 1u << i;
+    }
+  
+    // Produits en attente d'une opération: toutes les opérations sont acceptées dès que le stock le permet
+    it->produits[i] = 0;
+    if (((poste->masqueProds[bot->mode] >> i) & 1) && bot->stockProduits[i] == 0) {
+      it->produits[i] = poste->opsAcceptees[bot->mode];
+    }
+  }
+}
+
+/**
+ * Définit si un composant C(j+1) peut être injecté: en stock et injectable sur l'anneau en cours
+ */
+static bool injectable(Usine *usine, int j) {
+  return usine->stockComposants[j] > 0 && ((usine->injectables >> j) & 1);
+}
+
+/**
+ * Tourniquet: chaque type de composant à son tour, dans l'ordre des produits
+ */
+static int choisir_tourniquet(Usine *usine) {
+  static int k, j;
+  
+  for (k = 0; k < __anneau->nbProd; k++) {
+    j = (usine->prochainComposant + k) % __anneau->nbProd;
+  
+    if (injectable(usine, j)) {
+      usine->prochainComposant = (j + 1) % __anneau->nbProd;
+      return j;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Retourne le type de plus grand score parmi ceux qui ont du stock, en partant
+ * du tourniquet pour départager les égalités
+ */
+static int choisir_meilleur(Usine *usine, long *score) {
+  static int k, j, meilleur;
+  
+  meilleur = -1;
+  
+  for (k = 0; k < __anneau->nbProd; k++) {
+    j = (usine->prochainComposant + k) % __anneau->nbProd;
+  
+    if (injectable(usine, j) && (meilleur < 0 || score[j] > score[meilleur])) {
+      meilleur = j;
+    }
+  }
+  
+  if (meilleur >= 0) {
+    usine->prochainComposant = (meilleur + 1) % __anneau->nbProd;
+  }
+  return meilleur;
+}
+
+/**
+ * Plus de travail restant d'abord: opérations des produits encore à lancer,
+ * estimées par composants restants x opérations / composants par produit
+ */
+static int choisir_travail(Usine *usine) {
+  static long score[NB_PROD_MAX];
+  static int j;
+  
+  for (j = 0; j < __anneau->nbProd; j++) {
+    // Numérateur commun: 6 est divisible par 1, 2 et 3 composants
+    score[j] = (long) usine->stockComposants[j] * __produits[j].nbOps * 6 / __produits[j].nbComp;
+  }
+  return choisir_meilleur(usine, score);
+}
+
+/**
+ * Goulot: charge de chaque opération (opérations restantes / robots capables),
+ * puis priorité aux produits qui sollicitent le plus les opérations chargées,
+ * pour que le goulot ne manque jamais de travail
+ */
+static int choisir_goulot(Usine *usine) {
+  static long charge[NB_OPS_MAX + 1], score[NB_PROD_MAX];
+  static int j, o, op;
+  
+  for (op = 0; op <= NB_OPS_MAX; op++) {
+    charge[op] = 0;
+  }
+  
+  for (j = 0; j < __anneau->nbProd; j++) {
+    for (o = 0; o < __produits[j].nbOps; o++) {
+      charge[(int) __produits[j].ops[o]] += usine->stockComposants[j] * 6 / __produits[j].nbComp;
+    }
+  }
+  
+  for (op = 1; op <= NB_OPS_MAX; op++) {
+    if (usine->capaciteOps[op] > 1) {
+      charge[op] /= usine->capaciteOps[op];
+    }
+  }
+  
+  for (j = 0; j < __anneau->nbProd; j++) {
+    score[j] = 0;
+    for (o = 0; o < __produits[j].nbOps; o++) {
+      score[j] += charge[(int) __produits[j].ops[o]];
+    }
+  }
+  return choisir_meilleur(usine, score);
+}
+
+/**
+ * Demande: au tourniquet, le premier type qu'un robot connecté peut prendre
+ * dans son état actuel (intérêt publié); rien tant qu'aucun robot n'en veut
+ */
+static int choisir_demande(Usine *usine) {
+  static unsigned int demande;
+  static int i, k, j;
+  
+  demande = 0;
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid != 0) {
+      demande |= __abonnes[i].interet.composants;
+    }
+  }
+  
+  for (k = 0; k < __anneau->nbProd; k++) {
+    j = (usine->prochainComposant + k) % __anneau->nbProd;
+  
+    if (injectable(usine, j) && ((demande >> j) & 1)) {
+      usine->prochainComposant = (j + 1) % __anneau->nbProd;
+      return j;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Politiques d'injection disponibles, la première par défaut
+ */
+static const PolitiqueInjection politiques[] = {
+  {"tourniquet",	choisir_tourniquet,	"chaque type de composant à son tour"},
+  {"travail",		choisir_travail,	"plus de travail restant d'abord"},
+  {"goulot",		choisir_goulot,		"produits qui sollicitent les opérations les plus chargées d'abord"},
+  {"demande",		choisir_demande,	"composants qu'un robot peut prendre maintenant, au tourniquet"}
+};
+
+#define NB_POLITIQUES	((int) (sizeof(politiques) / sizeof(politiques[0])))
+
+/**
+ * Retourne la politique d'injection nommée nom, NULL si elle n'existe pas
+ */
+const PolitiqueInjection* politique_injection(const char *nom) {
+  int i;
+  
+  for (i = 0; i < NB_POLITIQUES; i++) {
+    if (strcmp(politiques[i].nom, nom) == 0) {
+      return &politiques[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Affiche les politiques d'injection disponibles
+ */
+void politiques_injection_lister() {
+  int i;
+  
+  for (i = 0; i < NB_POLITIQUES; i++) {
+    printf("  %-12s %s\n", politiques[i].nom, politiques[i].description);
+  }
+}
+
+/**
+ * Lit une règle d'admission nom[:N]: seuil, conwip, occupation ou retroaction
+ * Retourne false si la règle est inconnue ou son paramètre invalide (N entier
+ * positif ou nul, 100 au plus pour occupation)
+ */
+bool admission_lire(Admission *a, const char *texte) {
+  static const char *noms[] = {"seuil", "conwip", "occupation", "retroaction"};
+  static const int defauts[] = {ADMISSION_SEUIL_DEFAUT, 8, 50, 0};
+  const int nbNoms = sizeof(noms) / sizeof(noms[0]);
+  const char *sep = strchr(texte, ':');
+  size_t n = sep ? (size_t) (sep - texte) : strlen(texte);
+  char *fin;
+  long parametre;
+  int t;
+  
+  memset(a, 0, sizeof(Admission));
+  
+  for (t = 0; t < nbNoms; t++) {
+    if (strlen(noms[t]) == n && strncmp(noms[t], texte, n) == 0) {
+      a->type = (TypeAdmission) t;
+  
+      if (sep) {
+	errno = 0;
+	parametre = strtol(sep + 1, &fin, 10);
+	if (fin == sep + 1 || *fin != '\0' || errno != 0 || parametre < 0 || parametre > INT_MAX
+	    || (a->type == ADMISSION_OCCUPATION && parametre > 100)) {
+	  return false;
+	}
+	a->parametre = (int) parametre;
+      } else {
+	a->parametre = defauts[t];
+      }
+      a->plafond = a->type == ADMISSION_CONWIP ? a->parametre : 0;
+  
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Description de la règle d'admission et de son état courant
+ */
+char* admission_desc(Admission *a) {
+  static char desc[64];
+  
+  switch (a->type) {
+    case ADMISSION_SEUIL:
+      sprintf(desc, "seuil: plus de %d cases vides", a->parametre);
+      break;
+    case ADMISSION_CONWIP:
+      sprintf(desc, "conwip: encours < %d", a->plafond);
+      break;
+    case ADMISSION_OCCUPATION:
+      sprintf(desc, "occupation: < %d %% des cases", a->parametre);
+      break;
+    case ADMISSION_RETROACTION:
+      sprintf(desc, "retroaction: encours < %d (délai %d, inactivité %d %%)", a->plafond, a->delai, a->inactivite);
+      break;
+  }
+  return desc;
+}
+
+/**
+ * Nombre de composants du produit qui en demande le plus: en dessous, un
+ * plafond d'encours empêcherait de réunir les composants d'un produit
+ */
+static int encours_minimum() {
+  static int i, n;
+  
+  for (i = 0, n = 1; i < __anneau->nbProd; i++) {
+    if (__produits[i].nbComp > n) {
+      n = __produits[i].nbComp;
+    }
+  }
+  return n;
+}
+
+/**
+ * CONWIP: à la fin de chaque fenêtre de mesure, monte le plafond si aucun produit n'a
+ * été expédié à plafond atteint. Les composants en cours peuvent appartenir à des
+ * produits différents (ou être dispersés chez plusieurs robots) sans qu'aucun ne soit
+ * complet: sans expédition, l'encours ne baisse plus et aucune injection ne le complète
+ */
+static void admission_debloquer(Usine *usine) {
+  static Admission *a;
+  
+  a = &usine->admission;
+  
+  if (a->plafond < encours_minimum()) {
+    a->plafond = encours_minimum();
+  }
+  
+  if (__anneau->generation - a->debutFenetre < (unsigned int) (ADMISSION_FENETRE_TOURS * __anneau->nbCases)) {
+    return;
+  }
+  
+  if (a->expediesFenetre == 0 && usine->encours >= a->plafond && a->plafond < __anneau->nbCases - 1) {
+    a->plafond++;
+  }
+  
+  a->debutFenetre = __anneau->generation;
+  a->delaiFenetre = 0;
+  a->expediesFenetre = 0;
+}
+
+/**
+ * Rétroaction: à la fin de chaque fenêtre de mesure, baisse le plafond si les
+ * produits tournent trop longtemps, le monte si les robots manquent de travail
+ */
+static void admission_ajuster(Usine *usine) {
+  static Admission *a;
+  static unsigned long notifications;
+  static unsigned int rotations;
+  static int i, robots, cible;
+  
+  a = &usine->admission;
+  
+  notifications = 0;
+  robots = 0;
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid != 0) {
+      notifications += __abonnes[i].notifications;
+      robots++;
+    }
+  }
+  
+  if (a->plafond == 0) {
+    a->plafond = __anneau->nbCases / 2;
+    a->debutFenetre = __anneau->generation;
+    a->notificationsFenetre = notifications;
+  }
+  
+  rotations = __anneau->generation - a->debutFenetre;
+  if (rotations < (unsigned int) (ADMISSION_FENETRE_TOURS * __anneau->nbCases) || robots == 0) {
+    return;
+  }
+  
+  // Mesures de la fenêtre: délai moyen, part des rotations où un robot n'avait rien devant lui
+  cible = a->parametre > 0 ? a->parametre : ADMISSION_DELAI_TOURS * __anneau->nbCases;
+  a->delai = a->expediesFenetre > 0 ? a->delaiFenetre / a->expediesFenetre : 0;
+  a->inactivite = 100 - (int) ((notifications - a->notificationsFenetre) * 100 / ((unsigned long) robots * rotations));
+  
+  // Aucune expédition à plafond atteint: la ligne est bloquée, l'encours doit remonter
+  if (a->expediesFenetre == 0 && usine->encours >= a->plafond) {
+    a->plafond++;
+  } else if (a->expediesFenetre > 0 && a->delai > cible) {
+    a->plafond--;
+  } else if (a->inactivite > ADMISSION_INACTIVITE) {
+    a->plafond++;
+  }
+  
+  if (a->plafond < encours_minimum()) {
+    a->plafond = encours_minimum();
+  }
+  if (a->plafond > __anneau->nbCases - 1) {
+    a->plafond = __anneau->nbCases - 1;
+  }
+  
+  a->debutFenetre = __anneau->generation;
+  a->notificationsFenetre = notifications;
+  a->delaiFenetre = 0;
+  a->expediesFenetre = 0;
+}
+
+/**
+ * Définit si la règle d'admission permet d'injecter un composant à cette rotation
+ */
+static bool admission_accepter(Usine *usine) {
+  static Admission *a;
+  
+  a = &usine->admission;
+  
+  switch (a->type) {
+    case ADMISSION_SEUIL:
+      return nb_cases_vides() > a->parametre;
+  
+    case ADMISSION_CONWIP:
+      admission_debloquer(usine);
+      return usine->encours < a->plafond;
+  
+    case ADMISSION_OCCUPATION:
+      return (__anneau->nbCases - nb_cases_vides()) * 100 < a->parametre * __anneau->nbCases;
+  
+    case ADMISSION_RETROACTION:
+      admission_ajuster(usine);
+      return usine->encours < a->plafond;
+  }
+  return true;
+}
+
+/**
+ * Prend en compte la connexion (delta = 1) ou la déconnexion (delta = -1) d'un robot
+ * dans la capacité de la ligne par opération; à la connexion, les capacités, le rôle,
+ * le mode et le stock du robot sont recopiés dans son abonnement (bot->idx), pour le
+ * placement, le pilotage des rôles et la reprise
+ */
+void usine_robot(Usine *usine, Robot *bot, int delta) {
+  static Abonne *a;
+  static int i;
+  
+  a = &(__abonnes[bot->idx]);
+  
+  // Déconnexion: opération du rôle courant, éventuellement réattribué par le pilotage
+  if (delta < 0) {
+    usine->capaciteOps[a->op]--;
+    return;
+  }
+  
+  usine->capaciteOps[(int) bot->ops[0]]++;
+  
+  a->id = bot->id;
+  a->masqueOps = masque(bot->ops, 0);
+  a->masqueProds = masque(bot->prods, 1);
+  a->masqueDegrades = masque(bot->prodsDegrades, 1);
+  a->op = bot->ops[0];
+  a->mode = bot->mode;
+  a->composantsRefuses = 0;
+  a->actionsFenetre = a->actions;
+  for (i = 0; i < NB_PROD_MAX; i++) {
+    a->stockComposants[i] = bot->stockComposants[i];
+    a->stockProduits[i] = bot->stockProduits[i];
+  }
+}
+
+/**
+ * Reprise après la disparition du robot abonné en idx, sémaphore pris: abonnement et
+ * connexion libérés, composants de son stock local rendus au stock du serveur pour être
+ * réinjectés (un produit en stock compte pour tous ses composants), et robots capables
+ * d'une opération ou d'un produit restant au plan que plus aucun robot ne couvre passés
+ * en mode dégradé
+ * Retourne le nombre de composants rendus au stock
+ */
+int usine_reprendre(Usine *usine, int idx) {
+  Abonne *a = &(__abonnes[idx]);
+  Abonne *b;
+  unsigned int opsRestantes = 0, prodsRestants = 0, opsCouvertes = 0, prodsCouverts = 0;
+  int i, j, c, rendus = 0;
+  
+  if (a->pos >= 0 && __connexions[a->pos] == a->pid) {
+    __connexions[a->pos] = 0;
+  }
+  __atomic_store_n(&a->pid, 0, __ATOMIC_RELEASE);
+  a->marque = false;
+  usine->capaciteOps[a->op]--;
+  
+  // Encours perdu avec le robot: ses composants seront injectés de nouveau
+  for (i = 0; i < __anneau->nbProd; i++) {
+    c = a->stockComposants[i] + a->stockProduits[i] * __produits[i].nbComp;
+    usine->stockComposants[i] += c;
+    usine->encours -= c;
+    rendus += c;
+  
+    if (usine->produitsPlanifies[i] > 0) {
+      prodsRestants |= 1u << i;
+      opsRestantes |= masque(__produits[i].ops, 0);
+    }
+  }
+  
+  // Couverture des robots restants: en mode normal leur opération et leurs produits,
+  // en mode dégradé toutes leurs opérations et leurs produits dégradés
+  for (j = 0; j < __anneau->nbRobots; j++) {
+    b = &(__abonnes[j]);
+    if (b->pid == 0) {
+      continue;
+    }
+    opsCouvertes  |= b->mode == NORMAL ? 1u << b->op : b->masqueOps;
+    prodsCouverts |= b->mode == NORMAL ? b->masqueProds : b->masqueDegrades;
+  }
+  
+  opsRestantes  &= ~opsCouvertes;
+  prodsRestants &= ~prodsCouverts;
+  
+  // Robots passés en mode dégradé: appliqué par chacun à son prochain battement
+  for (j = 0; j < __anneau->nbRobots && (opsRestantes || prodsRestants); j++) {
+    b = &(__abonnes[j]);
+    if (b->pid != 0 && b->mode == NORMAL && ((b->masqueOps & opsRestantes) || (b->masqueDegrades & prodsRestants))) {
+      b->mode = DEGRADE;
+    }
+  }
+  
+  return rendus;
+}
+
+/**
+ * Lit un pilotage des rôles: fixes ou adaptatifs
+ * Retourne false s'il est inconnu
+ */
+bool roles_lire(TypeRoles *t, const char *texte) {
+  if (strcmp(texte, "fixes") == 0) {
+    *t = ROLES_FIXES;
+  } else if (strcmp(texte, "adaptatifs") == 0) {
+    *t = ROLES_ADAPTATIFS;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Description du pilotage des rôles et de son état courant
+ */
+char* roles_desc(Roles *r) {
+  static char desc[64];
+  
+  if (r->type == ROLES_FIXES) {
+    sprintf(desc, "fixes");
+  } else if (r->goulot == 0) {
+    sprintf(desc, "adaptatifs: %d changements, aucun goulot", r->changements);
+  } else {
+    sprintf(desc, "adaptatifs: %d changements, goulot op %d", r->changements, r->goulot);
+  }
+  return desc;
+}
+
+/**
+ * Pilotage des rôles: nombre de couples (produit restant au plan, opération de sa gamme)
+ * pris en charge par un robot abonné, selon son mode: en mode normal l'opération de son
+ * rôle sur les produits de son rôle, en mode dégradé toutes ses opérations sur ses
+ * produits dégradés
+ */
+static int roles_couverture(Usine *usine) {
+  static Abonne *a;
+  static int i, j, k, o, couverts;
+  
+  couverts = 0;
+  for (i = 0; i < __anneau->nbProd; i++) {
+    if (usine->produitsPlanifies[i] <= 0) {
+      continue;
+    }
+    for (k = 0; (o = __produits[i].ops[k]) != 0; k++) {
+      for (j = 0; j < __anneau->nbRobots; j++) {
+	a = &(__abonnes[j]);
+	if (a->pid != 0 && (a->mode == NORMAL
+	  ? a->op == o && ((a->masqueProds >> i) & 1)
+	  : ((a->masqueOps >> o) & 1) && ((a->masqueDegrades >> i) & 1))) {
+	  couverts++;
+	  break;
+	}
+      }
+    }
+  }
+  return couverts;
+}
+
+/**
+ * Pilotage des rôles: change le rôle et le mode du robot abonné a, si aucun couple
+ * (produit, opération) restant au plan n'y perd son robot
+ * Retourne false si le changement est refusé
+ */
+static bool roles_changer(Usine *usine, Abonne *a, int op, unsigned int prods, Mode mode) {
+  int couverts = roles_couverture(usine);
+  int opAvant = a->op;
+  unsigned int prodsAvant = a->masqueProds;
+  Mode modeAvant = a->mode;
+  
+  a->op = op;
+  a->masqueProds = prods;
+  a->mode = mode;
+  
+  if (roles_couverture(usine) < couverts) {
+    a->op = opAvant;
+    a->masqueProds = prodsAvant;
+    a->mode = modeAvant;
+    return false;
+  }
+  
+  usine->capaciteOps[opAvant]--;
+  usine->capaciteOps[op]++;
+  usine->roles.changements++;
+  return true;
+}
+
+/**
+ * Regroupement des composants d'un produit entièrement injecté chez le robot qui en détient
+ * le plus, seul à les accepter encore; les autres rendent les leurs à la première case vide.
+ * Sans cela, les robots qui les acceptent se les prennent et se les rendent (un composant
+ * isolé est remis sur l'anneau vide) sans qu'aucun ne réunisse le produit. Sur une ligne de
+ * plusieurs anneaux, le robot est choisi sur toute la ligne: les robots des autres anneaux
+ * refusent tous ces composants, que les stations lui transfèrent.
+ * Appelé à chaque fenêtre du pilotage des rôles pour tous les produits et, avec les rôles
+ * fixes, à chaque tour pour ceux de produits (bit i: produit i+1)
+ */
+static void roles_regrouper(Usine *usine, unsigned int produits) {
+  static Abonne *a, *collecteur;
+  static bool ailleurs;
+  static int i, j, k, n;
+  
+  for (i = 0; i < __anneau->nbProd; i++) {
+    collecteur = NULL;
+    ailleurs = false;
+  
+    if (((produits >> i) & 1) && usine->stockComposants[i] == 0 && usine->produitsPlanifies[i] > 0) {
+      for (j = 0; j < __anneau->nbRobots; j++) {
+	a = &(__abonnes[j]);
+	if (a->pid != 0 && a->stockComposants[i] > 0
+	  && (((a->mode == NORMAL ? a->masqueProds : a->masqueDegrades) >> i) & 1)
+	  && (collecteur == NULL || a->stockComposants[i] > collecteur->stockComposants[i])) {
+	  collecteur = a;
+	}
+      }
+  
+      // Plusieurs anneaux: le robot qui en détient le plus sur la ligne, sur le premier anneau à égalité
+      n = collecteur != NULL ? collecteur->stockComposants[i] : 0;
+      usine->anneaux[usine->anneau].collecte[i] = n;
+      for (k = 0; k < usine->nbAnneaux; k++) {
+	if (k != usine->anneau && (usine->anneaux[k].collecte[i] > n || (usine->anneaux[k].collecte[i] == n && n > 0 && k < usine->anneau))) {
+	  ailleurs = true;
+	}
+      }
+    } else {
+      usine->anneaux[usine->anneau].collecte[i] = 0;
+    }
+  
+    for (j = 0; j < __anneau->nbRobots; j++) {
+      a = &(__abonnes[j]);
+      if (ailleurs || (collecteur != NULL && a != collecteur)) {
+	a->composantsRefuses |= 1u << i;
+      } else {
+	a->composantsRefuses &= ~(1u << i);
+      }
+    }
+  }
+}
+
+/**
+ * Pilotage des rôles: un relevé par rotation et, à la fin de chaque fenêtre de mesure,
+ * au plus un changement. Le goulot est l'opération restant au plan dont l'attente par
+ * robot capable est la plus forte; à partir de ROLES_GOULOT, le robot capable du goulot
+ * dont l'opération est deux fois moins chargée (la moins chargée, puis le robot le moins
+ * utilisé) en prend le rôle et accepte en plus les produits du goulot qu'il sait traiter,
+ * sinon un robot capable du goulot passe en mode dégradé. Un rôle n'est repris que par
+ * un autre goulot: revenir au rôle d'origine quand l'anneau se vide ralentit la fin du
+ * plan, le travail restant étant alors dans le stock des robots. Aucun changement ne
+ * laisse une opération d'un produit restant au plan sans robot
+ */
+static void roles_ajuster(Usine *usine) {
+  static Roles *r;
+  static Abonne *a;
+  static Case *c;
+  static double pression[NB_OPS_MAX + 1];
+  static int capacite[NB_OPS_MAX + 1];
+  static Abonne *choisi;
+  static unsigned int requises, prodsGoulot, utilisation, moindre;
+  static int i, o, goulot;
+  
+  r = &usine->roles;
+  
+  // Relevé d'une case par rotation, celle devant l'entrée du serveur: tout le contenu de
+  // l'anneau y passe en un tour, la moyenne sur un tour est celle de l'anneau entier
+  c = anneau_case(ANNEAU_POS_SERV_IN);
+  if (c->type == PRODUIT && c->p.etat >= 0) {
+    r->attente[(int) c->p.ops[c->p.etat]]++;
+  }
+  r->releves++;
+  
+  if (__anneau->generation - r->debutFenetre < (unsigned int) (ROLES_FENETRE_TOURS * __anneau->nbCases)) {
+    return;
+  }
+  
+  // Capacité par opération: rôle des robots en mode normal, toutes leurs opérations en mode dégradé
+  memset(capacite, 0, sizeof(capacite));
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    if (a->pid == 0) {
+      continue;
+    }
+    for (o = 1; o <= NB_OPS_MAX; o++) {
+      if (a->mode == NORMAL ? o == a->op : (a->masqueOps >> o) & 1) {
+	capacite[o]++;
+      }
+    }
+  }
+  
+  // Goulot parmi les opérations des produits restant au plan (une opération sans robot compte double)
+  for (i = 0, requises = 0; i < __anneau->nbProd; i++) {
+    if (usine->produitsPlanifies[i] > 0) {
+      requises |= masque(__produits[i].ops, 0);
+    }
+  }
+  
+  for (o = 1, goulot = 0; o <= NB_OPS_MAX; o++) {
+    pression[o] = (double) r->attente[o] * __anneau->nbCases / r->releves / (capacite[o] > 0 ? capacite[o] : 0.5);
+    if (((requises >> o) & 1) && (goulot == 0 || pression[o] > pression[goulot])) {
+      goulot = o;
+    }
+  }
+  r->goulot = goulot != 0 && pression[goulot] >= ROLES_GOULOT ? goulot : 0;
+  
+  if (r->goulot != 0) {
+    for (i = 0, prodsGoulot = 0; i < __anneau->nbProd; i++) {
+      if (usine->produitsPlanifies[i] > 0 && ((masque(__produits[i].ops, 0) >> goulot) & 1)) {
+	prodsGoulot |= 1u << i;
+      }
+    }
+  
+    // Rôle réattribué: robot capable du goulot dont l'opération est deux fois moins chargée
+    for (i = 0, choisi = NULL; i < __anneau->nbRobots; i++) {
+      a = &(__abonnes[i]);
+      if (a->pid == 0 || a->mode != NORMAL || !((a->masqueOps >> goulot) & 1) || a->op == goulot
+	|| pression[a->op] * 2 >= pression[goulot]) {
+	continue;
+      }
+      utilisation = a->actions - a->actionsFenetre;
+      if (choisi == NULL || pression[a->op] < pression[choisi->op]
+	|| (pression[a->op] == pression[choisi->op] && utilisation < moindre)) {
+	choisi = a;
+	moindre = utilisation;
+      }
+    }
+  
+    if (choisi == NULL || !roles_changer(usine, choisi, goulot, choisi->masqueProds | (prodsGoulot & choisi->masqueDegrades), NORMAL)) {
+      // Sinon mode dégradé: robot capable du goulot et de ses produits, le moins utilisé
+      for (i = 0, choisi = NULL; i < __anneau->nbRobots; i++) {
+	a = &(__abonnes[i]);
+	if (a->pid == 0 || a->mode != NORMAL || !((a->masqueOps >> goulot) & 1) || a->op == goulot || !(a->masqueDegrades & prodsGoulot)) {
+	  continue;
+	}
+	utilisation = a->actions - a->actionsFenetre;
+	if (choisi == NULL || utilisation < moindre) {
+	  choisi = a;
+	  moindre = utilisation;
+	}
+      }
+  
+      if (choisi != NULL) {
+	roles_changer(usine, choisi, choisi->op, choisi->masqueProds, DEGRADE);
+      }
+    }
+  }
+  
+  roles_regrouper(usine, ~0u);
+  
+  // Nouvelle fenêtre de mesure
+  memset(r->attente, 0, sizeof(r->attente));
+  r->releves = 0;
+  r->debutFenetre = __anneau->generation;
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    __abonnes[i].actionsFenetre = __abonnes[i].actions;
+  }
+}
+
+/**
+ * Lit un mode de placement: regulier ou flux
+ * Retourne false s'il est inconnu
+ */
+bool placement_lire(TypePlacement *t, const char *texte) {
+  if (strcmp(texte, "regulier") == 0) {
+    *t = PLACEMENT_REGULIER;
+  } else if (strcmp(texte, "flux") == 0) {
+    *t = PLACEMENT_FLUX;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Nom du mode de placement
+ */
+const char* placement_nom(TypePlacement t) {
+  return t == PLACEMENT_FLUX ? "flux" : "regulier";
+}
+
+/**
+ * Trajet du produit i sur l'anneau, en rotations, pour les robots abonnes[ordre[r]] en positions[r]
+ * (rangés dans le sens de circulation depuis la sortie du serveur): ses composants vont du port
+ * d'injection le plus proche au premier robot qui accepte le produit, le produit au robot suivant
+ * qui effectue l'opération attendue, et ainsi de suite jusqu'au premier port d'expédition.
+ * Une étape qu'aucun robot n'effectue compte un tour
+ */
+static int placement_trajet(int i, const Abonne *abonnes, const int *ordre, const int *positions, int k, const Ports *ports) {
+  Produit *p = &(__produits[i]);
+  int n = __anneau->nbCases;
+  int trajet, pos, etat, r, j, d, e;
+  
+  // Assemblage
+  for (r = 0; r < k && !((abonnes[ordre[r]].masqueProds >> i) & 1); r++);
+  
+  if (r == k) {
+    return n * (p->nbOps + 1);
+  }
+  
+  pos = positions[r];
+  d = (ANNEAU_POS_SERV_OUT - pos + n) % n;
+  for (j = 0; j < ports->nbInjections; j++) {
+    e = (ports->injections[j] - pos + n) % n;
+    d = e < d ? e : d;
+  }
+  trajet = p->nbComp * d;
+  etat = (abonnes[ordre[r]].masqueOps >> p->ops[0]) & 1;
+  
+  // Opérations: le robot qui vient de travailler ne retrouve le produit qu'après un tour
+  for (; etat < p->nbOps; etat++) {
+    for (j = 1; j <= k && abonnes[ordre[(r + j) % k]].op != p->ops[etat]; j++);
+  
+    if (j > k) {
+      trajet += n;
+      continue;
+    }
+  
+    r = (r + j) % k;
+    d = (pos - positions[r] + n) % n;
+    trajet += d > 0 ? d : n;
+    pos = positions[r];
+  }
+  
+  d = (pos - ANNEAU_POS_SERV_IN + n) % n;
+  for (j = 0; j < ports->nbExpeditions; j++) {
+    e = (pos - ports->expeditions[j] + n) % n;
+    d = e < d ? e : d;
+  }
+  return trajet + d;
+}
+
+/**
+ * Trajet total des produits, poids[i] produits i à fabriquer
+ */
+static long placement_cout(const Abonne *abonnes, const int *poids, const int *ordre, const int *positions, int k, const Ports *ports) {
+  long cout = 0;
+  int i;
+  
+  for (i = 0; i < __anneau->nbProd; i++) {
+    cout += (long) poids[i] * placement_trajet(i, abonnes, ordre, positions, k, ports);
+  }
+  return cout;
+}
+
+/**
+ * Recherche exhaustive: tous les ordres des rangs r..k-1, le meilleur est gardé dans meilleur[]
+ */
+static void placement_explorer(const Abonne *abonnes, int *ordre, int r, int k, const int *poids, const int *positions, int *meilleur, long *cout, const Ports *ports) {
+  long essai;
+  int j, v;
+  
+  if (r == k) {
+    essai = placement_cout(abonnes, poids, ordre, positions, k, ports);
+    if (essai < *cout) {
+      *cout = essai;
+      memcpy(meilleur, ordre, k * sizeof(int));
+    }
+    return;
+  }
+  
+  for (j = r; j < k; j++) {
+    v = ordre[r]; ordre[r] = ordre[j]; ordre[j] = v;
+    placement_explorer(abonnes, ordre, r + 1, k, poids, positions, meilleur, cout, ports);
+    v = ordre[r]; ordre[r] = ordre[j]; ordre[j] = v;
+  }
+}
+
+/**
+ * Déplace l'élément x de ordre[] au rang y
+ */
+static void placement_deplacer(int *ordre, int x, int y) {
+  int v = ordre[x];
+  
+  if (x < y) {
+    memmove(&ordre[x], &ordre[x + 1], (y - x) * sizeof(int));
+  } else {
+    memmove(&ordre[y + 1], &ordre[y], (x - y) * sizeof(int));
+  }
+  ordre[y] = v;
+}
+
+/**
+ * Calcule le placement des robots de abonnes[], copie des abonnés de l'anneau, sans rien
+ * modifier: en mode PLACEMENT_FLUX, l'ordre des robots sur l'anneau est choisi pour minimiser
+ * le trajet des produits restant à fabriquer, d'après les gammes et les capacités des robots.
+ * places[i] reçoit la position de l'abonné i, sa position actuelle hors mode PLACEMENT_FLUX
+ * Retourne le trajet moyen estimé d'un produit, en rotations
+ */
+double usine_placement(Usine *usine, const Abonne *abonnes, int *places) {
+  int ordre[__anneau->nbRobots], positions[__anneau->nbRobots], meilleur[__anneau->nbRobots];
+  int poids[NB_PROD_MAX];
+  int n = __anneau->nbCases;
+  int libres[n];
+  int i, k, m, r, x, y, produits;
+  long cout, essai;
+  bool ameliore;
+  
+  // Produits restant à fabriquer, tous les produits une fois le plan terminé
+  for (i = 0, produits = 0; i < __anneau->nbProd; i++) {
+    poids[i] = usine_plan_termine(usine) ? 1 : usine->produitsPlanifies[i];
+    produits += poids[i];
+  }
+  
+  // Abonnés dans le sens de circulation depuis la sortie du serveur
+  for (i = 0, k = 0; i < __anneau->nbRobots; i++) {
+    if (abonnes[i].pid == 0) {
+      continue;
+    }
+    for (r = k; r > 0 && abonnes[ordre[r - 1]].pos < abonnes[i].pos; r--) {
+      ordre[r] = ordre[r - 1];
+    }
+    ordre[r] = i;
+    k++;
+  }
+  
+  for (r = 0; r < k; r++) {
+    positions[r] = abonnes[ordre[r]].pos;
+  }
+  
+  // Positions entre la sortie et l'entrée du serveur, hors ports supplémentaires
+  for (i = ANNEAU_POS_SERV_OUT + 1, m = 0; i < ANNEAU_POS_SERV_IN; i++) {
+    if (!usine_port(usine, i)) {
+      libres[m++] = i;
+    }
+  }
+  
+  // Flux: robots régulièrement espacés sur ces positions, meilleur ordre parmi tous pour
+  // une petite ligne, sinon amélioré par déplacements successifs d'un robot
+  if (usine->placement == PLACEMENT_FLUX && k > 0 && k <= m && k <= PLACEMENT_FLUX_ROBOTS_MAX) {
+    for (r = 0; r < k; r++) {
+      positions[r] = libres[m - (r + 1) * (m + 1) / (k + 1)];
+    }
+  
+    cout = placement_cout(abonnes, poids, ordre, positions, k, &usine->ports);
+    if (k <= PLACEMENT_EXHAUSTIF_ROBOTS) {
+      memcpy(meilleur, ordre, k * sizeof(int));
+      placement_explorer(abonnes, ordre, 0, k, poids, positions, meilleur, &cout, &usine->ports);
+      memcpy(ordre, meilleur, k * sizeof(int));
+    }
+  
+    do {
+      ameliore = false;
+      for (x = 0; x < k; x++) {
+	for (y = 0; y < k; y++) {
+	  if (x == y) {
+	    continue;
+	  }
+	  placement_deplacer(ordre, x, y);
+	  essai = placement_cout(abonnes, poids, ordre, positions, k, &usine->ports);
+	  if (essai < cout) {
+	    cout = essai;
+	    ameliore = true;
+	  } else {
+	    placement_deplacer(ordre, y, x);
+	  }
+	}
+      }
+    } while (ameliore);
+  
+  }
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    places[i] = abonnes[i].pos;
+  }
+  for (r = 0; r < k; r++) {
+    places[ordre[r]] = positions[r];
+  }
+  
+  return k > 0 && produits > 0 ? (double) placement_cout(abonnes, poids, ordre, positions, k, &usine->ports) / produits : 0;
+}
+
+/**
+ * Applique aux abonnés et aux connexions les positions places[] calculées par usine_placement
+ * sur la copie abonnes[]: un abonné reparti ou remplacé depuis la copie est laissé en place
+ */
+void usine_placement_appliquer(const Abonne *abonnes, const int *places) {
+  int i;
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (abonnes[i].pid != 0 && __abonnes[i].pid == abonnes[i].pid && __abonnes[i].pos >= 0) {
+      __connexions[__abonnes[i].pos] = 0;
+    }
+  }
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (abonnes[i].pid != 0 && __abonnes[i].pid == abonnes[i].pid && places[i] >= 0) {
+      __abonnes[i].pos = places[i];
+      __connexions[places[i]] = abonnes[i].pid;
+    }
+  }
+}
+
+/**
+ * Place les robots abonnés d'après usine_placement, directement sur l'anneau: les positions
+ * des abonnés et les connexions sont mises à jour
+ * Retourne le trajet moyen estimé d'un produit, en rotations
+ */
+double usine_placer(Usine *usine) {
+  int places[__anneau->nbRobots];
+  double trajet;
+  
+  trajet = usine_placement(usine, __abonnes, places);
+  usine_placement_appliquer(__abonnes, places);
+  return trajet;
+}
+
+/**
+ * Publie dans l'abonnement a les contenus de case sur lesquels le robot peut agir,
+ * et son stock local: le serveur le reprend si le robot disparaît
+ */
+void poste_publier(Poste *poste, Abonne *a) {
+  static int i;
+  
+  poste_interet(poste, &a->interet);
+  
+  for (i = 0; i < __anneau->nbProd; i++) {
+    a->stockComposants[i] = poste->bot.stockComposants[i];
+    a->stockProduits[i] = poste->bot.stockProduits[i];
+  }
+}
+
+/**
+ * Définit si le rôle, le mode ou les composants refusés inscrits dans l'abonnement a diffèrent de ceux du poste
+ */
+bool poste_consignes_changees(Poste *poste, Abonne *a) {
+  return a->mode != poste->bot.mode || a->op != poste->op || a->masqueProds != poste->masqueProds[NORMAL]
+    || a->composantsRefuses != poste->composantsRefuses;
+}
+
+/**
+ * Applique au poste le rôle, le mode et les composants refusés inscrits dans l'abonnement a
+ * La table de décision n'est recompilée que si le rôle ou les composants refusés changent
+ */
+void poste_suivre(Poste *poste, Abonne *a) {
+  poste->bot.mode = a->mode;
+  
+  if (a->op != poste->op || a->masqueProds != poste->masqueProds[NORMAL] || a->composantsRefuses != poste->composantsRefuses) {
+    poste->op = a->op;
+    poste->masqueProds[NORMAL] = a->masqueProds;
+    poste->composantsRefuses = a->composantsRefuses;
+    poste_compiler(poste);
+  }
+}
+
+/**
+ * Initialise le plan de production et le stock de composants nécessaires
+ */
+void usine_init(Usine *usine, const int *planifies) {
+  int i;
+  
+  for (i = 0; i < NB_PROD_MAX; i++) {
+    usine->produitsPlanifies[i] = i < __anneau->nbProd ? planifies[i] : 0;
+    usine->produitsFabriques[i] = 0;
+    usine->stockComposants[i] = usine->produitsPlanifies[i] * (i < __anneau->nbProd ? __produits[i].nbComp : 0);
+  }
+  
+  for (i = 0; i <= NB_OPS_MAX; i++) {
+    usine->capaciteOps[i] = 0;
+  }
+  
+  usine->numeroSerie = 0;
+  usine->prochainComposant = 0;
+  usine->politique = &politiques[0];
+  usine->encours = 0;
+  usine->delaiCumule = 0;
+  
+  usine->placement = PLACEMENT_FLUX;
+  
+  memset(&usine->roles, 0, sizeof(Roles));
+  usine->roles.type = ROLES_FIXES;
+  
+  admission_lire(&usine->admission, "seuil");
+  
+  usine->nbAnneaux = 1;
+  usine->anneau = 0;
+  usine->injectables = ~0u;
+  usine->regroupes = 0;
+  
+  memset(&usine->ports, 0, sizeof(Ports));
+}
+
+/**
+ * Répartit la ligne sur nbAnneaux anneaux: chacun part de la règle d'admission et du
+ * pilotage des rôles de l'usine, à appeler une fois l'usine configurée
+ */
+void usine_ligne(Usine *usine, int nbAnneaux) {
+  int k;
+  
+  usine->nbAnneaux = nbAnneaux;
+  usine->anneau = 0;
+  
+  for (k = 0; k < nbAnneaux; k++) {
+    usine->anneaux[k].admission = usine->admission;
+    usine->anneaux[k].roles = usine->roles;
+    usine->anneaux[k].composantsAcceptes = 0;
+    memset(usine->anneaux[k].collecte, 0, sizeof(usine->anneaux[k].collecte));
+  }
+}
+
+/**
+ * Fait de l'anneau k celui en cours de traitement: son admission et ses rôles remplacent
+ * ceux de l'anneau précédent, mis de côté. L'anneau courant doit aussi être sélectionné
+ * (anneau_selectionner())
+ */
+void usine_anneau(Usine *usine, int k) {
+  if (k == usine->anneau) {
+    return;
+  }
+  
+  usine->anneaux[usine->anneau].admission = usine->admission;
+  usine->anneaux[usine->anneau].roles = usine->roles;
+  
+  usine->admission = usine->anneaux[k].admission;
+  usine->roles = usine->anneaux[k].roles;
+  usine->anneau = k;
+}
+
+/**
+ * Composants acceptés par les robots de l'anneau courant, dans leur rôle et leur mode,
+ * hors composants regroupés chez un autre robot
+ */
+static unsigned int anneau_composants_acceptes() {
+  static unsigned int acceptes;
+  static Abonne *a;
+  static int i;
+  
+  for (i = 0, acceptes = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    if (a->pid != 0) {
+      acceptes |= (a->mode == NORMAL ? a->masqueProds : a->masqueDegrades) & ~a->composantsRefuses;
+    }
+  }
+  return acceptes;
+}
+
+/**
+ * Définit si un robot de l'anneau courant accepte le contenu de la case c dans son rôle
+ * et son mode: le produit d'un composant, l'opération attendue d'un produit
+ */
+static bool anneau_accepte(Case *c) {
+  static Abonne *a;
+  static int i, o;
+  
+  if (c->type == COMPOSANT) {
+    return (anneau_composants_acceptes() >> (c->c.num - 1)) & 1;
+  }
+  
+  o = c->p.ops[c->p.etat];
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    if (a->pid != 0 && (a->mode == NORMAL
+      ? a->op == o && ((a->masqueProds >> (c->p.num - 1)) & 1)
+      : ((a->masqueOps >> o) & 1) && ((a->masqueDegrades >> (c->p.num - 1)) & 1))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Lit des stations de transfert "A:pa-B:pb,...": position pa de l'anneau A reliée à la
+ * position pb de l'anneau B; nbCases[k]: cases de l'anneau k, positions du serveur exclues
+ * Retourne le nombre de stations, -1 si la liste est invalide
+ */
+int stations_lire(Station *stations, const char *texte, const int *nbCases, int nbAnneaux) {
+  Station *s;
+  int n, lus, k;
+  
+  for (n = 0; *texte; n++) {
+    if (n == NB_STATIONS_MAX) {
+      return -1;
+    }
+    s = &stations[n];
+  
+    if (sscanf(texte, "%d:%d-%d:%d%n", &s->anneaux[0], &s->positions[0], &s->anneaux[1], &s->positions[1], &lus) != 4
+      || (texte[lus] != ',' && texte[lus] != '\0') || s->anneaux[0] == s->anneaux[1]) {
+      return -1;
+    }
+  
+    for (k = 0; k < 2; k++) {
+      if (s->anneaux[k] < 0 || s->anneaux[k] >= nbAnneaux
+	|| s->positions[k] <= ANNEAU_POS_SERV_OUT || s->positions[k] >= nbCases[s->anneaux[k]] - 1) {
+	return -1;
+      }
+      s->transferts[k] = 0;
+    }
+  
+    texte += texte[lus] == ',' ? lus + 1 : lus;
+  }
+  
+  return n;
+}
+
+/**
+ * Description d'une station de transfert: A:pa-B:pb
+ */
+char* station_desc(Station *s) {
+  static char str[DESC_TAILLE];
+  
+  sprintf(str, "%d:%d-%d:%d", s->anneaux[0], s->positions[0], s->anneaux[1], s->positions[1]);
+  return str;
+}
+
+/**
+ * Contenu de la case c à transférer hors de l'anneau courant: composant ou produit
+ * en cours qu'aucun robot de l'anneau n'accepte
+ */
+static bool station_a_transferer(Case *c) {
+  return c->type != VIDE && (c->type == COMPOSANT || c->p.etat >= 0) && !anneau_accepte(c);
+}
+
+/**
+ * Transfert par la station s du contenu de sa case sur l'anneau anneaux[sens] vers l'autre
+ * anneau, s'il y est accepté et pas sur le sien. La case d'arrivée doit être vide et l'anneau
+ * d'arrivée garder plus de STATION_CASES_VIDES cases vides, où ses robots posent leurs
+ * produits; si la case d'arrivée attend elle-même le transfert inverse, les deux contenus
+ * sont échangés sans occuper de case: deux anneaux pleins ne se bloquent pas.
+ * Un produit terminé reste sur son anneau: le serveur est relié à tous
+ * Appelée sémaphores des deux anneaux pris dans le cas multi-processus; l'anneau courant
+ * est rétabli au retour
+ * Retourne true si un contenu a été transféré
+ */
+bool station_traiter(Station *s, VueAnneau *vues, int sens) {
+  static VueAnneau courant;
+  static Case *depart, *arrivee, echange;
+  static bool transfert, inverse;
+  
+  anneau_memoriser(&courant);
+  transfert = false;
+  
+  anneau_selectionner(&vues[s->anneaux[sens]]);
+  depart = anneau_case(s->positions[sens]);
+  
+  if (station_a_transferer(depart)) {
+    anneau_selectionner(&vues[s->anneaux[1 - sens]]);
+    arrivee = anneau_case(s->positions[1 - sens]);
+  
+    if (arrivee->type == VIDE) {
+      transfert = nb_cases_vides() > STATION_CASES_VIDES && anneau_accepte(depart);
+      inverse = false;
+    } else {
+      // Échange: chaque contenu attendu sur l'autre anneau
+      inverse = station_a_transferer(arrivee) && anneau_accepte(depart);
+      if (inverse) {
+	anneau_selectionner(&vues[s->anneaux[sens]]);
+	inverse = anneau_accepte(arrivee);
+      }
+      transfert = inverse;
+    }
+  
+    if (transfert) {
+      echange = *arrivee;
+      anneau_selectionner(&vues[s->anneaux[1 - sens]]);
+      metriques_case(arrivee->type, depart->type);
+      anneau_selectionner(&vues[s->anneaux[sens]]);
+      metriques_case(depart->type, arrivee->type);
+  
+      arrivee->c = depart->c;
+      arrivee->p = depart->p;
+      arrivee->type = depart->type;
+      depart->c = echange.c;
+      depart->p = echange.p;
+      depart->type = echange.type;
+  
+      s->transferts[sens]++;
+      if (inverse) {
+	s->transferts[1 - sens]++;
+      }
+    }
+  }
+  
+  anneau_selectionner(&courant);
+  return transfert;
+}
+
+/**
+ * Lit des ports supplémentaires "i:N,e:N,...": injection (i) ou expédition (e) en position N
+ * d'un anneau de nbCases cases, hors positions du serveur, chacun une seule fois
+ * Retourne false si la liste est invalide
+ */
+bool ports_lire(Ports *ports, const char *texte, int nbCases) {
+  Ports lus = {0};
+  char type;
+  int pos, n, i;
+  
+  while (*texte) {
+    if (sscanf(texte, "%c:%d%n", &type, &pos, &n) != 2 || (texte[n] != ',' && texte[n] != '\0')
+      || pos <= ANNEAU_POS_SERV_OUT || pos >= nbCases - 1) {
+      return false;
+    }
+  
+    for (i = 0; i < lus.nbInjections; i++) {
+      if (lus.injections[i] == pos) {
+	return false;
+      }
+    }
+    for (i = 0; i < lus.nbExpeditions; i++) {
+      if (lus.expeditions[i] == pos) {
+	return false;
+      }
+    }
+  
+    if (type == 'i' && lus.nbInjections < NB_PORTS_MAX) {
+      lus.injections[lus.nbInjections++] = pos;
+    } else if (type == 'e' && lus.nbExpeditions < NB_PORTS_MAX) {
+      lus.expeditions[lus.nbExpeditions++] = pos;
+    } else {
+      return false;
+    }
+  
+    texte += texte[n] == ',' ? n + 1 : n;
+  }
+  
+  *ports = lus;
+  return true;
+}
+
+/**
+ * Description des ports supplémentaires: i:N,e:N,... ou aucun
+ */
+char* ports_desc(Ports *ports) {
+  static char str[PORTS_DESC_TAILLE];
+  int i, n = 0;
+  
+  str[0] = '\0';
+  for (i = 0; i < ports->nbInjections && n < PORTS_DESC_TAILLE; i++) {
+    n += snprintf(str + n, PORTS_DESC_TAILLE - n, "%si:%d", n ? "," : "", ports->injections[i]);
+  }
+  for (i = 0; i < ports->nbExpeditions && n < PORTS_DESC_TAILLE; i++) {
+    n += snprintf(str + n, PORTS_DESC_TAILLE - n, "%se:%d", n ? "," : "", ports->expeditions[i]);
+  }
+  
+  return n ? str : "aucun";
+}
+
+/**
+ * Branche le processus pid aux ports supplémentaires de l'anneau courant (0: débranche),
+ * comme aux positions ANNEAU_POS_SERV_IN et ANNEAU_POS_SERV_OUT: aucun robot n'y est placé
+ */
+void ports_brancher(Ports *ports, pid_t pid) {
+  int i;
+  
+  for (i = 0; i < ports->nbInjections; i++) {
+    __connexions[ports->injections[i]] = pid;
+  }
+  for (i = 0; i < ports->nbExpeditions; i++) {
+    __connexions[ports->expeditions[i]] = pid;
+  }
+}
+
+/**
+ * Définit si la position pos est un port supplémentaire du serveur
+ */
+bool usine_port(Usine *usine, int pos) {
+  static int i;
+  
+  for (i = 0; i < usine->ports.nbInjections; i++) {
+    if (usine->ports.injections[i] == pos) {
+      return true;
+    }
+  }
+  for (i = 0; i < usine->ports.nbExpeditions; i++) {
+    if (usine->ports.expeditions[i] == pos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Expédition du produit terminé de la case en position pos, s'il y en a un
+ */
+static void usine_expedier(Usine *usine, int pos, ActionServeur *a) {
+  static Case *c;
+  
+  c = anneau_case(pos);
+  if (c->type != PRODUIT || c->p.etat != -1) {
+    return;
+  }
+  
+  usine->produitsFabriques[c->p.num - 1]++;
+  usine->produitsPlanifies[c->p.num - 1]--;
+  usine->encours -= c->p.nbComp;
+  usine->delaiCumule += __anneau->generation - c->p.injection;
+  usine->admission.delaiFenetre += __anneau->generation - c->p.injection;
+  usine->admission.expediesFenetre++;
+  journal(EV_EXPEDITION, PRODUIT, c->p.num, 0, pos, -1, c->p.id);
+  METRIQUE_AJOUTER(__metriques->expeditions[c->p.num - 1], 1);
+  METRIQUE_AJOUTER(__metriques->rotationsExpedies[c->p.num - 1], __anneau->generation - c->p.injection);
+  metriques_case(PRODUIT, VIDE);
+  
+  a->expedition = true;
+  a->expeditions++;
+  a->p = c->p;
+  c->type = VIDE;
+}
+
+/**
+ * Injection d'un composant dans la case en position pos, si elle est vide et que
+ * l'admission et la politique d'injection le permettent
+ */
+static void usine_injecter(Usine *usine, int pos, ActionServeur *a) {
+  static Case *c;
+  static int j;
+  
+  c = anneau_case(pos);
+  if (c->type != VIDE) {
+    return;
+  }
+  
+  if (usine_composants_restants(usine) == 0) {
+    a->epuise = true;
+    return;
+  }
+  if (!admission_accepter(usine) || (j = usine->politique->choisir(usine)) < 0) {
+    return;
+  }
+  
+  c->c.num = j + 1;
+  c->c.id = ++usine->numeroSerie;
+  c->c.injection = __anneau->generation;
+  c->type = COMPOSANT;
+  usine->stockComposants[j]--;
+  usine->encours++;
+  
+  journal(EV_INJECTION, COMPOSANT, c->c.num, 0, pos, 0, c->c.id);
+  METRIQUE_AJOUTER(__metriques->injections[j], 1);
+  metriques_case(VIDE, COMPOSANT);
+  
+  if (!a->injection) {
+    a->c = c->c;
+  }
+  a->injection = true;
+  a->injections++;
+}
+
+/**
+ * Traitement par le serveur de ses cases d'entrée et de sortie, puis de ses ports supplémentaires
+ * robots: au moins un robot est connecté, la distribution est possible
+ */
+ActionServeur usine_traiter(Usine *usine, bool robots) {
+  static ActionServeur a;
+  static int j;
+  
+  a.expedition = a.injection = a.epuise = false;
+  a.expeditions = a.injections = 0;
+  
+  if (usine->roles.type == ROLES_ADAPTATIFS) {
+    roles_ajuster(usine);
+  } else if (__anneau->generation % __anneau->nbCases == 0) {
+    // Rôles fixes: après un tour sans injection ni expédition, regroupement des produits
+    // entièrement injectés, jusqu'à leur expédition
+    if (__anneau->generation - usine->roles.activite >= (unsigned int) __anneau->nbCases) {
+      for (j = 0; j < __anneau->nbProd; j++) {
+	if (usine->stockComposants[j] == 0) {
+	  usine->regroupes |= 1u << j;
+	}
+      }
+    }
+    roles_regrouper(usine, usine->regroupes);
+  }
+  
+  // Plusieurs anneaux: composants qu'un robot de cet anneau accepte, ou qu'aucun robot de la ligne n'accepte
+  if (usine->nbAnneaux > 1) {
+    usine->anneaux[usine->anneau].composantsAcceptes = anneau_composants_acceptes();
+    usine->injectables = 0;
+    for (j = 0; j < usine->nbAnneaux; j++) {
+      usine->injectables |= usine->anneaux[j].composantsAcceptes;
+    }
+    usine->injectables = usine->anneaux[usine->anneau].composantsAcceptes | ~usine->injectables;
+  }
+  
+  // Produits terminés en entrée et aux ports d'expédition: je les stocke
+  usine_expedier(usine, ANNEAU_POS_SERV_IN, &a);
+  for (j = 0; j < usine->ports.nbExpeditions; j++) {
+    usine_expedier(usine, usine->ports.expeditions[j], &a);
+  }
+  
+  // Distribution en sortie et aux ports d'injection
+  if (robots) {
+    usine_injecter(usine, ANNEAU_POS_SERV_OUT, &a);
+    for (j = 0; j < usine->ports.nbInjections; j++) {
+      usine_injecter(usine, usine->ports.injections[j], &a);
+    }
+  }
+  if (a.injection || a.expedition) {
+    usine->roles.activite = __anneau->generation;
+  }
+  
+  return a;
+}
+
+/**
+ * Retourne le délai moyen des produits expédiés, en rotations
+ */
+double usine_delai_moyen(Usine *usine) {
+  int i, n;
+  
+  for (i = 0, n = 0; i < __anneau->nbProd; i++) {
+    n += usine->produitsFabriques[i];
+  }
+  return n > 0 ? (double) usine->delaiCumule / n : 0;
+}
+
+/**
+ * Retourne le nombre de composants restants en stock
+ */
+int usine_composants_restants(Usine *usine) {
+  static int i, num;
+  for (i = 0, num = 0; i < __anneau->nbProd; i++) {
+    num += usine->stockComposants[i];
+  }
+  return num;
+}
+
+/**
+ * Définit si tous les produits planifiés ont été expédiés
+ */
+bool usine_plan_termine(Usine *usine) {
+  static int i;
+  for (i = 0; i < __anneau->nbProd; i++) {
+    if (usine->produitsPlanifies[i] > 0) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,429 @@
+#ifndef ATELIER_H
+#define ATELIER_H
+
+/*********************************************/
+/* Règles de fabrication du serveur et des   */
+/* robots, indépendantes des IPC             */
+/*********************************************/
+
+#include "common.h"
+#include "journal.h"
+
+#define NB_ETATS_STOCK		8	// États du stock local d'un produit: composants (0..3) x produit (0..1)
+#define ETAT_STOCK(bot, i)	((bot)->stockComposants[i] * 2 + (bot)->stockProduits[i])
+
+/**
+ * Structure Poste: état de travail d'un robot
+ * Les capacités du robot sont compilées par poste_init() en masques et en table de décision
+ */
+typedef struct {
+  Robot bot;
+  Produit produitsStock[NB_PROD_MAX];	// Produit en stock, par type
+  Composant composants[NB_PROD_MAX][NB_COMP_MAX];	// Composants en stock, par type, dans l'ordre de réception
+  int prochainePose;			// Prochain produit du stock à poser sur une case VIDE (tourniquet)
+  
+  int op;				// Opération effectuée sur les produits pris en mode normal (ops[0], ou rôle imposé)
+  unsigned int composantsRefuses;	// Bit i: composants du produit i+1 regroupés chez un autre robot par le serveur
+  unsigned int masqueOps;		// Bit o: opération o réalisable
+  unsigned int masqueProds[2];		// [mode] bit i: produit i+1 accepté (mode normal: prods, ou rôle imposé)
+  unsigned int opsAcceptees[2];		// [mode] bit o: produit en attente de l'opération o accepté
+  unsigned char decision[2][2][NB_PROD_MAX][NB_OPS_MAX + 1];	// [mode][COMPOSANT-1 | PRODUIT-1][produit-1][opération attendue]
+									// bit ETAT_STOCK: prise acceptée
+} Poste;
+
+#define ADMISSION_SEUIL_DEFAUT	3	// Injection si plus de 3 cases vides (règle d'origine)
+#define ADMISSION_FENETRE_TOURS	2	// Rétroaction et CONWIP bloqué: mesure sur 2 tours d'anneau
+#define ADMISSION_DELAI_TOURS	4	// Rétroaction: délai visé par défaut, en tours d'anneau
+#define ADMISSION_INACTIVITE	50	// Rétroaction: part des rotations sans notification au-delà de laquelle les robots manquent de travail (%)
+
+#define ROLES_FENETRE_TOURS	2	// Pilotage des rôles: mesure sur 2 tours d'anneau
+#define ROLES_GOULOT		1	// Goulot: au moins 1 produit en attente de l'opération, en moyenne, par robot qui l'effectue
+
+#define NB_STATIONS_MAX		16	// Stations de transfert d'une ligne de plusieurs anneaux
+#define NB_PORTS_MAX		8	// Ports d'injection, ou d'expédition, du serveur en plus de ceux d'origine
+#define PORTS_DESC_TAILLE	(2 * NB_PORTS_MAX * 16)	// Description des ports: ",i:N" par port, N entier
+#define STATION_CASES_VIDES	ADMISSION_SEUIL_DEFAUT	// Transfert si l'anneau d'arrivée garde plus de cases vides (règle d'injection d'origine)
+
+#define PLACEMENT_FLUX_ROBOTS_MAX	32	// Au-delà, placement régulier: chaque passe de l'optimisation est quadratique en robots
+#define PLACEMENT_EXHAUSTIF_ROBOTS	8	// Jusque-là, tous les ordres des robots sont essayés (8! ordres)
+
+/**
+ * Placement des robots sur l'anneau
+ */
+typedef enum {
+  PLACEMENT_REGULIER,	// Robots répartis régulièrement, dans l'ordre de connexion (anneau_position_libre())
+  PLACEMENT_FLUX	// Ordre des robots choisi selon les gammes, replanifié à chaque connexion (PLACEMENT_FLUX_ROBOTS_MAX robots)
+} TypePlacement;
+
+/**
+ * Rôles des robots: opération effectuée et produits acceptés en mode normal, et mode
+ */
+typedef enum {
+  ROLES_FIXES,		// Rôles donnés au lancement des robots, mode changé par SIGUSR2 seulement
+  ROLES_ADAPTATIFS	// Rôles et modes réattribués par le serveur selon le goulot mesuré sur l'anneau
+} TypeRoles;
+
+/**
+ * Structure Roles: pilotage des rôles des robots par le serveur
+ */
+typedef struct {
+  TypeRoles type;
+  unsigned int debutFenetre;		// Génération du début de la fenêtre de mesure
+  int releves;				// Relevés de la fenêtre, un par rotation
+  int attente[NB_OPS_MAX + 1];		// Produits en attente de chaque opération vus devant l'entrée du serveur
+  int goulot;				// Dernier goulot relevé, 0: aucun
+  int changements;			// Rôles et modes changés par le pilotage
+  unsigned int activite;		// Génération de la dernière injection ou expédition
+} Roles;
+
+struct Usine;
+
+/**
+ * Règles d'admission: quand le serveur peut injecter un composant
+ */
+typedef enum {
+  ADMISSION_SEUIL,		// Plus de N cases vides sur l'anneau
+  ADMISSION_CONWIP,		// Moins de N composants en cours (injectés, produit non expédié)
+  ADMISSION_OCCUPATION,		// Moins de N % de cases occupées
+  ADMISSION_RETROACTION		// Plafond d'encours ajusté selon le délai mesuré et l'inactivité des robots
+} TypeAdmission;
+
+/**
+ * Structure Admission: contrôle de l'encours injecté sur la ligne
+ */
+typedef struct {
+  TypeAdmission type;
+  int parametre;		// Seuil de cases vides, plafond d'encours, occupation visée (%), ou délai visé (0: défaut)
+  int plafond;			// Plafond d'encours courant (ADMISSION_CONWIP, ADMISSION_RETROACTION)
+  unsigned int debutFenetre;	// Rétroaction et CONWIP: génération du début de la fenêtre de mesure
+  unsigned long delaiFenetre;	// Somme des délais des produits expédiés dans la fenêtre
+  int expediesFenetre;
+  unsigned long notificationsFenetre;	// Notifications des robots au début de la fenêtre
+  int delai;			// Dernières mesures de la rétroaction: délai moyen et inactivité (%)
+  int inactivite;
+} Admission;
+
+/**
+ * Structure EtatAnneau: état du serveur propre à chaque anneau d'une ligne de plusieurs anneaux
+ */
+typedef struct {
+  Admission admission;
+  Roles roles;
+  unsigned int composantsAcceptes;	// Bit i: composant C(i+1) accepté par un robot de l'anneau, à son dernier traitement
+  int collecte[NB_PROD_MAX];		// Regroupement: plus grand stock de composants du produit i+1 chez un robot de l'anneau
+} EtatAnneau;
+
+/**
+ * Structure Station: station de transfert entre deux anneaux de la ligne
+ * Un contenu qu'aucun robot de son anneau n'accepte passe sur l'autre si l'un des siens l'accepte
+ */
+typedef struct {
+  int anneaux[2];	// Anneaux reliés
+  int positions[2];	// Position de la station sur chacun
+  int transferts[2];	// Contenus passés de anneaux[i] à l'autre anneau
+} Station;
+
+/**
+ * Structure Ports: positions où le serveur injecte des composants et expédie les produits
+ * terminés, en plus de ANNEAU_POS_SERV_OUT et ANNEAU_POS_SERV_IN (option --ports=)
+ */
+typedef struct {
+  int nbInjections;
+  int injections[NB_PORTS_MAX];
+  int nbExpeditions;
+  int expeditions[NB_PORTS_MAX];
+} Ports;
+
+/**
+ * Structure PolitiqueInjection: choix du type de composant à distribuer
+ * choisir() est appelée quand la case de sortie est libre et qu'il reste des composants;
+ * elle retourne l'indice du produit, ou -1 pour ne rien injecter à cette rotation
+ */
+typedef struct {
+  const char *nom;
+  int (*choisir)(struct Usine *usine);
+  const char *description;
+} PolitiqueInjection;
+
+/**
+ * Structure Usine: plan de production et stocks du serveur
+ */
+typedef struct Usine {
+  int produitsPlanifies[NB_PROD_MAX];	// Nombre de produits à fabriquer
+  int produitsFabriques[NB_PROD_MAX];	// Nombre de produits fabriqués
+  int stockComposants[NB_PROD_MAX];	// Stock de composants = produitsPlanifies * nbComp
+  int numeroSerie;			// Dernier numéro de série attribué à un composant
+  int prochainComposant;		// Prochain type de composant à distribuer (tourniquet)
+  const PolitiqueInjection *politique;	// Politique d'injection (tourniquet par défaut)
+  Admission admission;			// Règle d'admission (seuil de 3 cases vides par défaut)
+  int encours;				// Composants injectés dont le produit n'est pas expédié
+  unsigned long delaiCumule;		// Somme des délais des produits expédiés, en rotations
+  int capaciteOps[NB_OPS_MAX + 1];	// Robots connectés dont c'est l'opération en mode normal, par opération
+  TypePlacement placement;		// Placement des robots (flux par défaut)
+  Roles roles;				// Rôles des robots (fixes par défaut)
+  int nbAnneaux;			// Anneaux de la ligne (1 par défaut), servis par le même stock
+  int anneau;				// Anneau en cours de traitement: admission et rôles sont les siens (usine_anneau())
+  EtatAnneau anneaux[NB_ANNEAUX_MAX];	// Admission et rôles des autres anneaux, composants acceptés par chacun
+  unsigned int injectables;		// Bit i: composant C(i+1) injectable sur l'anneau en cours
+  unsigned int regroupes;		// Rôles fixes: bit i, composants du produit i+1 regroupés (anneau bloqué après son injection)
+  Ports ports;				// Ports supplémentaires du serveur (aucun par défaut)
+} Usine;
+
+/**
+ * Action d'un robot sur la case devant lui
+ */
+typedef enum {
+  ACTION_AUCUNE,
+  ACTION_PRISE_COMPOSANT,	// Composant stocké
+  ACTION_INITIALISATION,	// Composant pris, produit assemblé sans opération
+  ACTION_ASSEMBLAGE,		// Composant pris, produit assemblé et première opération effectuée
+  ACTION_OPERATION,		// Produit pris et opération effectuée
+  ACTION_POSE_COMPOSANT,	// Composant remis sur l'anneau
+  ACTION_POSE_PRODUIT		// Produit posé sur l'anneau
+} TypeAction;
+
+/**
+ * Structure Action: compte rendu d'un traitement, pour les tableaux de bord
+ */
+typedef struct {
+  TypeAction type;
+  Composant c;	// Composant pris ou posé
+  Produit p;	// Produit concerné, dans son état après l'action
+  Produit pris;	// Produit tel qu'il était sur la case (ACTION_OPERATION)
+  char op;	// Opération effectuée
+} Action;
+
+/**
+ * Structure ActionServeur: compte rendu d'un traitement du serveur
+ */
+typedef struct {
+  bool expedition;	// Produit terminé récupéré en entrée ou à un port d'expédition
+  Produit p;		// Dernier produit expédié
+  int expeditions;
+  bool injection;	// Composant déposé en sortie ou à un port d'injection
+  Composant c;		// Premier composant injecté
+  int injections;
+  bool epuise;		// Plus aucun composant à distribuer
+} ActionServeur;
+
+/**
+ * Initialise le poste d'un robot: stocks vides, mode NORMAL
+ * ops, prods et prodsDegrades sont des listes de numéros (voir lire_liste())
+ * Les recettes doivent être chargées: la table de décision en dépend
+ */
+void poste_init(Poste *poste, int id, char *ops, char *prods, char *prodsDegrades);
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ */
+bool puis_je_prendre_composant(Poste *poste, Case *c);
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ */
+bool puis_je_prendre_produit(Poste *poste, Case *c);
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ */
+Composant prendre_composant(Case *c);
+
+/**
+ * c'est pas assez clair le nom de la fonction ? :)
+ */
+Produit prendre_produit(Case *c);
+
+/**
+ * Traitement par le robot de la case devant lui
+ * Appelée sémaphore pris dans le cas multi-processus
+ */
+Action poste_traiter(Poste *poste);
+
+/**
+ * Calcule les contenus de case sur lesquels le robot peut agir
+ */
+void poste_interet(Poste *poste, Interet *it);
+
+/**
+ * Publie dans l'abonnement a les contenus de case sur lesquels le robot peut agir,
+ * et son stock local: le serveur le reprend si le robot disparaît
+ */
+void poste_publier(Poste *poste, Abonne *a);
+
+/**
+ * Définit si le rôle ou le mode inscrit dans l'abonnement a diffère de celui du poste
+ */
+bool poste_consignes_changees(Poste *poste, Abonne *a);
+
+/**
+ * Applique au poste le rôle et le mode inscrits dans l'abonnement a
+ * Appelée sémaphore pris dans le cas multi-processus, puis poste_publier()
+ */
+void poste_suivre(Poste *poste, Abonne *a);
+
+/**
+ * Initialise le plan de production et le stock de composants nécessaires
+ */
+void usine_init(Usine *usine, const int *planifies);
+
+/**
+ * Répartit la ligne sur nbAnneaux anneaux: chacun part de la règle d'admission et du
+ * pilotage des rôles de l'usine, à appeler une fois l'usine configurée
+ */
+void usine_ligne(Usine *usine, int nbAnneaux);
+
+/**
+ * Fait de l'anneau k celui en cours de traitement: son admission et ses rôles remplacent
+ * ceux de l'anneau précédent, mis de côté. L'anneau courant doit aussi être sélectionné
+ * (anneau_selectionner())
+ */
+void usine_anneau(Usine *usine, int k);
+
+/**
+ * Lit des stations de transfert "A:pa-B:pb,...": position pa de l'anneau A reliée à la
+ * position pb de l'anneau B; nbCases[k]: cases de l'anneau k, positions du serveur exclues
+ * Retourne le nombre de stations, -1 si la liste est invalide
+ */
+int stations_lire(Station *stations, const char *texte, const int *nbCases, int nbAnneaux);
+
+/**
+ * Description d'une station de transfert: A:pa-B:pb
+ */
+char* station_desc(Station *s);
+
+/**
+ * Transfert par la station s du contenu de sa case sur l'anneau anneaux[sens] vers l'autre
+ * anneau, s'il y est accepté et pas sur le sien: vers une case vide, ou en échange d'un
+ * contenu qui attend le transfert inverse
+ * Appelée sémaphores des deux anneaux pris dans le cas multi-processus; l'anneau courant
+ * est rétabli au retour
+ * Retourne true si un contenu a été transféré
+ */
+bool station_traiter(Station *s, VueAnneau *vues, int sens);
+
+/**
+ * Lit des ports supplémentaires "i:N,e:N,...": injection (i) ou expédition (e) en position N
+ * d'un anneau de nbCases cases, hors positions du serveur, chacun une seule fois
+ * Retourne false si la liste est invalide
+ */
+bool ports_lire(Ports *ports, const char *texte, int nbCases);
+
+/**
+ * Description des ports supplémentaires: i:N,e:N,... ou aucun
+ */
+char* ports_desc(Ports *ports);
+
+/**
+ * Branche le processus pid aux ports supplémentaires de l'anneau courant (0: débranche),
+ * comme aux positions ANNEAU_POS_SERV_IN et ANNEAU_POS_SERV_OUT: aucun robot n'y est placé
+ */
+void ports_brancher(Ports *ports, pid_t pid);
+
+/**
+ * Définit si la position pos est un port supplémentaire du serveur
+ */
+bool usine_port(Usine *usine, int pos);
+
+/**
+ * Retourne la politique d'injection nommée nom, NULL si elle n'existe pas
+ */
+const PolitiqueInjection* politique_injection(const char *nom);
+
+/**
+ * Affiche les politiques d'injection disponibles
+ */
+void politiques_injection_lister();
+
+/**
+ * Lit une règle d'admission nom[:N]: seuil, conwip, occupation ou retroaction
+ * Retourne false si la règle est inconnue ou son paramètre invalide
+ */
+bool admission_lire(Admission *a, const char *texte);
+
+/**
+ * Description de la règle d'admission et de son état courant
+ */
+char* admission_desc(Admission *a);
+
+/**
+ * Prend en compte la connexion (delta = 1) ou la déconnexion (delta = -1) d'un robot
+ * dans la capacité de la ligne par opération; à la connexion, les capacités, le rôle,
+ * le mode et le stock du robot sont recopiés dans son abonnement (bot->idx), pour le
+ * placement, le pilotage des rôles et la reprise
+ */
+void usine_robot(Usine *usine, Robot *bot, int delta);
+
+/**
+ * Reprise après la disparition du robot abonné en idx, sémaphore pris: abonnement et
+ * connexion libérés, stock local du robot rendu au stock du serveur, robots capables
+ * des opérations et produits qui n'ont plus de titulaire passés en mode dégradé
+ * Retourne le nombre de composants rendus au stock
+ */
+int usine_reprendre(Usine *usine, int idx);
+
+/**
+ * Lit un pilotage des rôles: fixes ou adaptatifs
+ * Retourne false s'il est inconnu
+ */
+bool roles_lire(TypeRoles *t, const char *texte);
+
+/**
+ * Description du pilotage des rôles et de son état courant
+ */
+char* roles_desc(Roles *r);
+
+/**
+ * Lit un mode de placement: regulier ou flux
+ * Retourne false s'il est inconnu
+ */
+bool placement_lire(TypePlacement *t, const char *texte);
+
+/**
+ * Nom du mode de placement
+ */
+const char* placement_nom(TypePlacement t);
+
+/**
+ * Calcule le placement des robots de abonnes[], copie des abonnés de l'anneau, sans rien
+ * modifier: en mode PLACEMENT_FLUX, l'ordre des robots sur l'anneau est choisi pour minimiser
+ * le trajet des produits restant à fabriquer, d'après les gammes et les capacités des robots.
+ * places[i] reçoit la position de l'abonné i, sa position actuelle hors mode PLACEMENT_FLUX
+ * Retourne le trajet moyen estimé d'un produit, en rotations
+ */
+double usine_placement(Usine *usine, const Abonne *abonnes, int *places);
+
+/**
+ * Applique aux abonnés et aux connexions les positions places[] calculées par usine_placement
+ * sur la copie abonnes[]: un abonné reparti ou remplacé depuis la copie est laissé en place
+ */
+void usine_placement_appliquer(const Abonne *abonnes, const int *places);
+
+/**
+ * Place les robots abonnés d'après usine_placement, directement sur l'anneau: les positions
+ * des abonnés et les connexions sont mises à jour
+ * Retourne le trajet moyen estimé d'un produit, en rotations
+ */
+double usine_placer(Usine *usine);
+
+/**
+ * Traitement par le serveur de ses cases d'entrée et de sortie
+ * robots: au moins un robot est connecté, la distribution est possible
+ */
+ActionServeur usine_traiter(Usine *usine, bool robots);
+
+/**
+ * Retourne le délai moyen des produits expédiés, en rotations
+ */
+double usine_delai_moyen(Usine *usine);
+
+/**
+ * Retourne le nombre de composants restants en stock
+ */
+int usine_composants_restants(Usine *usine);
+
+/**
+ * Définit si tous les produits planifiés ont été expédiés
+ */
+bool usine_plan_termine(Usine *usine);
+
+#endif
@@ -0,0 +1,300 @@
+#include "bench.h"
+
+/**
+ * Global vars: définis dans le fichier bench.h
+ * @var Usine usine			Stock du serveur (distribution)
+ * @var Produit recettes[]		Recettes chargées au démarrage (option --recettes=)
+ * @var Poste poste			Robot qui accepte tous les composants et toutes les opérations
+ * @var Case **composants		Cases contenant un composant
+ * @var Case **produitsEnCours		Cases contenant un produit en attente d'une opération
+ */
+
+int main(int argc, char *argv[]) {
+  static int tailles[] = {16, 256, 4096};
+  static int occupations[] = {0, 50, 100};
+  static Mesure mesures[] = {
+    {"tourner",				op_tourner,			NULL},
+    {"nb_cases_vides",			op_nb_cases_vides,		NULL},
+    {"desc_case",			op_desc_case,			NULL},
+    {"callback_new_connexion",		op_connexion,			NULL},
+    {"controle (requête, réponse)",	op_controle,			NULL},
+    {"puis_je_prendre_composant",	op_puis_je_prendre_composant,	avec_composants},
+    {"puis_je_prendre_produit",		op_puis_je_prendre_produit,	avec_produits},
+    {"distribution (usine_traiter)",	op_distribution,		NULL}
+  };
+  int nbTailles = sizeof(tailles) / sizeof(tailles[0]);
+  int nbOccupations = sizeof(occupations) / sizeof(occupations[0]);
+  int nbMesures = sizeof(mesures) / sizeof(mesures[0]);
+  char *fichierRecettes = RECETTES_FICHIER;
+  int nbCases = 0, occupation = -1;
+  int t, o, m;
+  
+  argc = lire_option_entier(argc, argv, "--cases=", &nbCases);
+  argc = lire_option_entier(argc, argv, "--occupation=", &occupation);
+  argc = lire_option_chaine(argc, argv, "--recettes=", &fichierRecettes);
+  
+  if (argc != 1 || nbCases == 1 || nbCases < 0 || occupation > 100) {
+    __raise(-1, "Usage: %s [--cases=N] [--occupation=0..100] [--recettes=FICHIER]", argv[0]);
+  }
+  
+  // Une seule configuration si elle est donnée
+  if (nbCases != 0) {
+    tailles[0] = nbCases;
+    nbTailles = 1;
+  }
+  if (occupation >= 0) {
+    occupations[0] = occupation;
+    nbOccupations = 1;
+  }
+  
+  nbProd = lire_recettes(fichierRecettes, recettes, plan);
+  
+#ifndef VERIFIER_ALLOCATIONS
+  printf("== Compilé sans -DVERIFIER_ALLOCATIONS: allocations non comptées\n");
+#endif
+  
+  for (t = 0; t < nbTailles; t++) {
+    for (o = 0; o < nbOccupations; o++) {
+      preparer(tailles[t], 0, occupations[o]);
+      
+      printf("\n== %d cases, %d robots, occupation %d%%\n", tailles[t], __anneau->nbRobots, occupations[o]);
+  
+      for (m = 0; m < nbMesures; m++) {
+	mesurer(&mesures[m]);
+      }
+  
+      liberer();
+    }
+  }
+  
+  return 0;
+}
+
+/**
+ * Construit un anneau de nbCases cases dont occupation % contiennent un
+ * composant ou un produit, avec nbRobots robots abonnés (0: 3/8 des cases)
+ */
+void preparer(int nbCases, int nbRobots, int occupation) {
+  unsigned int graine = BENCH_GRAINE;
+  char ops[NB_OPS_MAX * 3 + 1], prods[NB_PROD_MAX * 3 + 1];
+  Case *c;
+  int i, k;
+  
+  if (nbRobots == 0) {
+    nbRobots = nbCases * 3 / 8 > 1 ? nbCases * 3 / 8 : 2;
+  }
+  
+  __pid = getpid();
+  __anneau = calloc(1, anneau_taille(nbCases, nbRobots, nbProd));
+  
+  __anneau->id 		= __pid;
+  __anneau->nbCases 	= nbCases;
+  __anneau->nbRobots 	= nbRobots;
+  __anneau->nbProd 	= nbProd;
+  __anneau->taille 	= anneau_taille(nbCases, nbRobots, nbProd);
+  
+  anneau_geometrie();
+  anneau_recettes(recettes, plan);
+  controle_init();
+  boite = controle_ouvrir_boite(__pid);
+  
+  composants = calloc(nbCases, sizeof(Case *));
+  produitsEnCours = calloc(nbCases, sizeof(Case *));
+  nbComposants = nbProduitsEnCours = 0;
+  
+  //
+  // Cases: occupation % de cases pleines, moitié composants, moitié produits
+  for (i = 0; i < nbCases; i++) {
+    c = &(__cases[i]);
+    c->num  = i;
+    c->type = VIDE;
+  
+    if (rand_r(&graine) % 100 >= occupation) {
+      continue;
+    }
+  
+    k = rand_r(&graine) % nbProd;
+  
+    if (rand_r(&graine) % 2) {
+      c->type  = COMPOSANT;
+      c->c.num = k + 1;
+      c->c.id  = i;
+      composants[nbComposants++] = c;
+    } else {
+      c->type = PRODUIT;
+      c->p    = __produits[k];
+      c->p.id = i;
+      c->p.etat = rand_r(&graine) % c->p.nbOps;
+      produitsEnCours[nbProduitsEnCours++] = c;
+    }
+  }
+  metriques_init();
+  
+  //
+  // Serveur, puis robots connectés comme par le coordinateur: une entrée d'abonnement reste libre
+  __connexions[ANNEAU_POS_SERV_IN]  = __pid;
+  __connexions[ANNEAU_POS_SERV_OUT] = __pid;
+  
+  for (i = 0; i < nbRobots - 1; i++) {
+    __abonnes[i].pid = __pid;
+    __abonnes[i].pos = anneau_position_libre();
+    __connexions[__abonnes[i].pos] = __pid;
+    interet_tout(&__abonnes[i].interet);
+  }
+  
+  //
+  // Stock du serveur inépuisable, robot polyvalent au stock vide
+  usine_init(&usine, __plan);
+  for (i = 0; i < nbProd; i++) {
+    usine.stockComposants[i] = INT_MAX / nbProd;
+  }
+  
+  for (i = 0, k = 0; i < NB_OPS_MAX; i++) {
+    k += sprintf(ops + k, "%d,", i + 1);
+  }
+  for (i = 0, k = 0; i < nbProd; i++) {
+    k += sprintf(prods + k, "%d,", i + 1);
+  }
+  poste_init(&poste, 1, ops, prods, prods);
+  
+  n = 0;
+}
+
+/**
+ * Libère l'anneau synthétique
+ */
+void liberer() {
+  free(composants);
+  free(produitsEnCours);
+  free(__anneau);
+}
+
+/**
+ * Exécute op jusqu'à BENCH_DUREE_MS et affiche ns/op et allocations/op
+ */
+void mesurer(Mesure *m) {
+  struct timespec debut, fin;
+  unsigned long lot, total, allocations;
+  double duree;
+  
+  if (m->possible && !m->possible()) {
+    printf("  %-30s %12s\n", m->nom, "-");
+    return;
+  }
+  
+  // Lots de taille croissante jusqu'à la durée minimale
+  total = 0;
+  duree = 0;
+  allocations = allocations_nombre();
+  clock_gettime(CLOCK_MONOTONIC, &debut);
+  
+  for (lot = 1024; duree * 1000 < BENCH_DUREE_MS; lot *= 2) {
+    for (n = 0; n < lot; n++) {
+      m->operation();
+    }
+    total += lot;
+  
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    duree = (fin.tv_sec - debut.tv_sec) + (fin.tv_nsec - debut.tv_nsec) / 1e9;
+  }
+  
+  allocations = allocations_nombre() - allocations;
+  
+  printf("  %-30s %9.1f ns/op %8.3f alloc/op\n", m->nom, duree * 1e9 / total, (double) allocations / total);
+}
+
+/**
+ * L'anneau tourne d'un pas: avance de la tête et marquage des abonnés
+ */
+void op_tourner() {
+  __anneau->tete = (__anneau->tete + 1) % __anneau->nbCases;
+  puits += anneau_marquer_abonnes();
+}
+
+void op_nb_cases_vides() {
+  puits += nb_cases_vides();
+}
+
+void op_desc_case() {
+  puits += desc_case(anneau_case(n % __anneau->nbCases))[0];
+}
+
+/**
+ * Placement et abonnement d'un robot, comme callback_new_connexion() (robots replacés), puis déconnexion
+ */
+void op_connexion() {
+  static int pos, idx;
+  
+  pos = anneau_position_libre();
+  
+  for (idx = 0; idx < __anneau->nbRobots; idx++) {
+    if (__abonnes[idx].pid == 0) {
+      __abonnes[idx].pid = __pid;
+      __abonnes[idx].pos = pos;
+      interet_tout(&__abonnes[idx].interet);
+      break;
+    }
+  }
+  
+  if (idx < __anneau->nbRobots) {
+    poste.bot.idx = idx;
+    usine_robot(&usine, &poste.bot, 1);
+    puits += usine_placer(&usine);
+    usine_robot(&usine, &poste.bot, -1);
+  }
+  
+  puits += pos + idx;
+  
+  if (idx < __anneau->nbRobots) {
+    __abonnes[idx].pid = 0;
+  }
+}
+
+/**
+ * Aller-retour sur le canal de contrôle, robot et coordinateur dans le même processus: sans attente
+ */
+void op_controle() {
+  static RequeteControle q;
+  static ReponseControle r;
+  
+  q.type  = COORD_MSG_PING;
+  q.boite = boite;
+  controle_envoyer(&q);
+  
+  controle_recevoir(&q, 0);
+  r.type = q.type;
+  controle_repondre(q.boite, &r);
+  
+  controle_attendre_reponse(boite, &r, 0);
+  puits += r.type;
+}
+
+void op_puis_je_prendre_composant() {
+  puits += puis_je_prendre_composant(&poste, composants[n % nbComposants]);
+}
+
+void op_puis_je_prendre_produit() {
+  puits += puis_je_prendre_produit(&poste, produitsEnCours[n % nbProduitsEnCours]);
+}
+
+/**
+ * Traitement du serveur, case de sortie vidée à chaque appel pour que la distribution ait lieu
+ */
+void op_distribution() {
+  static Case *out;
+  static ActionServeur a;
+  
+  out = anneau_case(ANNEAU_POS_SERV_OUT);
+  out->type = VIDE;
+  
+  a = usine_traiter(&usine, true);
+  puits += a.injection;
+}
+
+bool avec_composants() {
+  return nbComposants > 0;
+}
+
+bool avec_produits() {
+  return nbProduitsEnCours > 0;
+}
@@ -0,0 +1,72 @@
+/*----------------------------------------*/
+/* Mesure des fonctions appelées à chaque */
+/* rotation, sur des anneaux synthétiques */
+/*----------------------------------------*/
+
+#include "common.c"
+#include "journal.c"
+#include "atelier.c"
+
+#include <time.h>
+
+#define BENCH_DUREE_MS		100	// Durée minimale de mesure de chaque fonction
+#define BENCH_GRAINE		1266	// Contenu des cases: tirage reproductible
+
+/**
+ * Structure Mesure: fonction mesurée sur l'anneau courant
+ */
+typedef struct {
+  const char *nom;
+  void (*operation)();
+  bool (*possible)();	// NULL: toujours mesurable
+} Mesure;
+
+/**
+ * Global vars: définis dans le fichier common.h
+ * @var Anneau *__anneau	Anneau synthétique, alloué dans le tas
+ */
+
+Usine usine;
+Produit recettes[NB_PROD_MAX]; // Recettes chargées au démarrage
+int plan[NB_PROD_MAX];
+int nbProd;
+Poste poste; // Robot qui accepte tous les composants et toutes les opérations
+
+Case **composants; // Cases contenant un composant
+Case **produitsEnCours; // Cases contenant un produit en attente d'une opération
+int nbComposants, nbProduitsEnCours;
+
+static volatile unsigned long puits; // Résultats des fonctions mesurées, pour que l'optimiseur les garde
+static unsigned long n; // Indice de l'appel en cours
+static int boite; // Boîte de réponse du canal de contrôle
+
+/**
+ * Construit un anneau de nbCases cases dont occupation % contiennent un
+ * composant ou un produit, avec nbRobots robots abonnés
+ */
+void preparer(int nbCases, int nbRobots, int occupation);
+
+/**
+ * Libère l'anneau synthétique
+ */
+void liberer();
+
+/**
+ * Exécute op jusqu'à BENCH_DUREE_MS et affiche ns/op et allocations/op
+ */
+void mesurer(Mesure *m);
+
+/**
+ * Fonctions mesurées
+ */
+void op_tourner();
+void op_nb_cases_vides();
+void op_desc_case();
+void op_connexion();
+void op_controle();
+void op_puis_je_prendre_composant();
+void op_puis_je_prendre_produit();
+void op_distribution();
+
+bool avec_composants();
+bool avec_produits();
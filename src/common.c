@@ -1,4 +1,5 @@
 ﻿#include "common.h"
+#include "allocations.c"
 
 /**
  * Global vars: définis dans le fichier common.h
@@ -6,24 +7,31 @@
  * @var int __shmid			ID de mémoire partagée
  * @var Anneau *__anneau		Anneau partagée dans la mémoire partagée
  * @var sem_t *__semaphore		Sémaphore de synchronisation de l'anneau
+ * @var Case *__cases			Cases de l'anneau (indices physiques)
+ * @var pid_t *__connexions		Processus connecté à chaque position
+ * @var Abonne *__abonnes		Abonnements des robots aux rotations
+ * @var Produit *__produits		Recettes, par numéro de produit - 1
+ * @var int *__plan			Plan de production, par numéro de produit - 1
+ * @var Controle *__controle		Requêtes des robots au coordinateur
+ * @var BoiteControle *__boites		Réponses du coordinateur, une boîte par robot
+ * @var Metriques *__metriques		Compteurs de l'anneau
+ * @var MetriquesRobot *__metriquesRobots	Compteurs de chaque abonnement
+ * Toutes, sauf __pid, désignent l'anneau courant du thread (anneau_selectionner())
  */
 
 // // // // // // // //
 // Shared functions  //
 // // // // // // // // 
 
-// Integer to Character
-char itoc(int i) {
-  static char c[1];
-  sprintf(c, "%d", i);
-  return c[0];
-}
-
-// Integer to Character
-int ctoi(char c) {
-  static char s[1];
-  sprintf(s, "%c", c);
-  return atoi(s);
+/**
+ * Tampon de description suivant
+ */
+static char* desc_tampon() {
+  static char tampons[DESC_TAMPONS][DESC_TAILLE];
+  static int i = 0;
+  
+  i = (i + 1) % DESC_TAMPONS;
+  return tampons[i];
 }
 
 /**
@@ -32,8 +40,8 @@ int ctoi(char c) {
 char* desc_composant(Composant *c) {
   static char *str;
   
-  str = malloc(255 * sizeof(char));
-  sprintf(str, "C%c", c->num);
+  str = desc_tampon();
+  sprintf(str, "C%d", c->num);
   return str;
 }
 
@@ -43,12 +51,12 @@ char* desc_composant(Composant *c) {
 char* desc_produit(Produit *p) {
   static char *str;
   
-  str = malloc(100*sizeof(char));
+  str = desc_tampon();
   
   if (p->etat == -1) {
-    sprintf(str, "P%c terminé", p->num);
+    sprintf(str, "P%d terminé", p->num);
   } else {
-    sprintf(str, "P%c attente Op%c", p->num, p->ops[p->etat]);
+    sprintf(str, "P%d attente Op%d", p->num, p->ops[p->etat]);
   }
   return str;
 }
@@ -63,12 +71,204 @@ char* desc_case(Case *c) {
   return (c->type == COMPOSANT) ? desc_composant(&(c->c)) : desc_produit(&(c->p));
 }
 
+/**
+ * Affiche une liste de numéros (opérations ou produits) sous la forme 1,2,5
+ */
+char* desc_liste(const char *liste) {
+  static char *str;
+  static int i, n;
+  
+  str = desc_tampon();
+  str[0] = '\0';
+  
+  for (i = 0, n = 0; liste[i] && n < DESC_TAILLE - 4; i++) {
+    n += sprintf(str + n, i ? ",%d" : "%d", liste[i]);
+  }
+  return str;
+}
+
+/**
+ * Arrondi au multiple de 8 supérieur: alignement des tableaux du segment
+ */
+static size_t aligner(size_t n) {
+  return (n + 7) & ~((size_t) 7);
+}
+
+/**
+ * Taille du segment d'un anneau de nbCases cases, nbRobots robots et nbProd produits
+ */
+size_t anneau_taille(int nbCases, int nbRobots, int nbProd) {
+  return aligner(sizeof(Anneau))
+    + aligner(nbCases * sizeof(Case))
+    + aligner(nbCases * sizeof(pid_t))
+    + aligner(nbRobots * sizeof(Abonne))
+    + aligner(nbProd * sizeof(Produit))
+    + aligner(nbProd * sizeof(int))
+    + aligner(sizeof(Controle))
+    + aligner(nbRobots * sizeof(BoiteControle))
+    + aligner(sizeof(Metriques))
+    + aligner(nbRobots * sizeof(MetriquesRobot));
+}
+
+/**
+ * Calcule l'adresse des tableaux qui suivent l'en-tête de l'anneau
+ */
+void anneau_geometrie() {
+  char *p = (char *) __anneau + aligner(sizeof(Anneau));
+  
+  __cases = (Case *) p;
+  p += aligner(__anneau->nbCases * sizeof(Case));
+  
+  __connexions = (pid_t *) p;
+  p += aligner(__anneau->nbCases * sizeof(pid_t));
+  
+  __abonnes = (Abonne *) p;
+  p += aligner(__anneau->nbRobots * sizeof(Abonne));
+  
+  __produits = (Produit *) p;
+  p += aligner(__anneau->nbProd * sizeof(Produit));
+  
+  __plan = (int *) p;
+  p += aligner(__anneau->nbProd * sizeof(int));
+  
+  __controle = (Controle *) p;
+  p += aligner(sizeof(Controle));
+  
+  __boites = (BoiteControle *) p;
+  p += aligner(__anneau->nbRobots * sizeof(BoiteControle));
+  
+  __metriques = (Metriques *) p;
+  p += aligner(sizeof(Metriques));
+  
+  __metriquesRobots = (MetriquesRobot *) p;
+}
+
+/**
+ * Clé du segment de l'anneau numero du projet: ftok() si le fichier projet existe, sinon
+ * ANNEAU_SHM_KEY + numero, pour que chaque anneau garde une clé distincte
+ */
+key_t anneau_cle(char *projet, int numero) {
+  key_t cle = ftok(projet, ANNEAU_SHM_KEY + numero);
+  
+  return cle != -1 ? cle : ANNEAU_SHM_KEY + numero;
+}
+
+/**
+ * Nom du sémaphore de l'anneau numero: SEM_NAME pour le premier, suivi du numéro pour les suivants
+ */
+char* anneau_nom_semaphore(int numero) {
+  static char nom[sizeof(SEM_NAME) + 16];
+  
+  if (numero == 0) {
+    return SEM_NAME;
+  }
+  sprintf(nom, "%s_%d", SEM_NAME, numero);
+  return nom;
+}
+
+/**
+ * Attache le segment de l'anneau numero en fonctionnement, ouvre son sémaphore et lit sa géométrie
+ */
+void anneau_attacher(char *projet, int numero) {
+  void *anneau_addr;
+  
+  // Taille 0: le segment existe déjà, sa taille est fixée par l'anneau
+  if ((__shmid = shmget(anneau_cle(projet, numero), 0, 0666)) == -1) {
+    __raise(-3, "======== ERROR: Impossible de se connecter à la mémoire partagé de l'anneau %d. Rassurez-vous que l'anneau est en cours de fonctionnement", numero);
+  }
+  // Attachement à une adresse choisie par le système
+  if ((anneau_addr = shmat(__shmid, NULL, 0)) == (void *) -1) {
+    __raise(-4, "======== ERROR: Attachement impossible");
+  }
+  printf("====== Connecté à la mémoire partagée %d\n", __shmid);
+  
+  // Initialisation de l'anneau
+  __anneau = (Anneau *) anneau_addr;
+  anneau_geometrie();
+  
+  if ((__semaphore = sem_open(anneau_nom_semaphore(numero), 0)) == SEM_FAILED) {
+    __raise(-3, "======== ERROR: Sémaphore %s introuvable", anneau_nom_semaphore(numero));
+  }
+  
+  printf("====== Anneau %d de %d cases, %d robots, %d produits\n", __anneau->numero, __anneau->nbCases, __anneau->nbRobots, __anneau->nbProd);
+}
+
+/**
+ * Mémorise dans v les adresses de l'anneau courant
+ */
+void anneau_memoriser(VueAnneau *v) {
+  v->shmid	= __shmid;
+  v->anneau	= __anneau;
+  v->semaphore	= __semaphore;
+  v->cases	= __cases;
+  v->connexions	= __connexions;
+  v->abonnes	= __abonnes;
+  v->produits	= __produits;
+  v->plan	= __plan;
+  v->controle	= __controle;
+  v->boites	= __boites;
+  v->metriques	= __metriques;
+  v->metriquesRobots	= __metriquesRobots;
+}
+
+/**
+ * Fait de l'anneau mémorisé dans v l'anneau courant du thread
+ */
+void anneau_selectionner(VueAnneau *v) {
+  __shmid	= v->shmid;
+  __anneau	= v->anneau;
+  __semaphore	= v->semaphore;
+  __cases	= v->cases;
+  __connexions	= v->connexions;
+  __abonnes	= v->abonnes;
+  __produits	= v->produits;
+  __plan	= v->plan;
+  __controle	= v->controle;
+  __boites	= v->boites;
+  __metriques	= v->metriques;
+  __metriquesRobots	= v->metriquesRobots;
+}
+
+/**
+ * Retourne la case située à la position logique pos de l'anneau
+ */
+Case* anneau_case(int pos) {
+  return &(__cases[(pos + __anneau->tete) % __anneau->nbCases]);
+}
+
+/**
+ * Position de connexion d'un nouveau robot: robots répartis régulièrement
+ * sur l'anneau, sinon première position libre en partant de la fin
+ */
+int anneau_position_libre() {
+  static int i, iter;
+  
+  iter = __anneau->nbCases / __anneau->nbRobots;
+  if (iter < 1) {
+    iter = 1;
+  }
+  
+  for (i = 0; i < __anneau->nbCases; i += iter) {
+    if (__connexions[i] == 0) {
+      return i;
+    }
+  }
+  
+  for (i = __anneau->nbCases - 1; i >= 0; i--) {
+    if (__connexions[i] == 0) {
+      break;
+    }
+  }
+  
+  return i;
+}
+
 int nb_cases_vides() {
   static int i, num;
   num = 0;
   
-  for (i = 0; i < ANNEAU_NUM_CASES; i++) {
-    if (__anneau->cases[i].type == VIDE) {
+  for (i = 0; i < __anneau->nbCases; i++) {
+    if (__cases[i].type == VIDE) {
       num++;
     }
   }
@@ -76,30 +276,811 @@ int nb_cases_vides() {
   return num;
 }
 
-Produit* init_produits() {
-  Produit *produits = (Produit *) malloc(sizeof(Produit) * NB_PROD);
+/**
+ * Appel système futex: les mots futex vivent dans le segment partagé,
+ * les opérations ne sont donc pas privées au processus
+ */
+static int futex(unsigned int *mot, int op, unsigned int val, const struct timespec *delai) {
+  return syscall(SYS_futex, mot, op, val, delai, NULL, 0);
+}
+
+/**
+ * Avance la génération et marque les abonnés intéressés par la case devant eux
+ * Doit être appelée sémaphore pris, juste après la rotation
+ */
+unsigned int anneau_marquer_abonnes() {
+  static unsigned int g;
+  static int i;
+  static Abonne *a;
   
-  produits[0].num    = '1';
-  produits[0].nbComp = 3;
-  sprintf(produits[0].ops, "1235");
-  produits[0].etat   = 0;
+  g = __anneau->generation + 1;
   
-  produits[1].num    = '2';
-  produits[1].nbComp = 3;
-  sprintf(produits[1].ops, "2416");
-  produits[1].etat   = 0;
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    
+    if (a->pid != 0 && interet_case(&a->interet, anneau_case(a->pos))) {
+      a->notifications++;
+      
+      // Mode libre: le réveil est différé, les robots traitent la rotation à tour de rôle
+      if (__anneau->libre) {
+	a->marque = true;
+      } else {
+	__atomic_store_n(&a->reveil, g, __ATOMIC_RELEASE);
+      }
+    } else if (a->pid != 0) {
+      METRIQUE_AJOUTER(__metriquesRobots[i].inactif, 1);
+    }
+  }
   
-  produits[2].num    = '3';
-  produits[2].nbComp = 1;
-  sprintf(produits[2].ops, "13513");
-  produits[2].etat   = 0;
+  __atomic_store_n(&__anneau->generation, g, __ATOMIC_RELEASE);
+  return g;
+}
+
+/**
+ * Réveille les processus en attente de la génération g
+ * Le serveur attend sur la génération (un seul réveil pour tous), chaque robot
+ * sur son propre mot: seuls les robots marqués sont réveillés
+ */
+void anneau_diffuser_rotation(unsigned int g) {
+  static int i;
   
-  produits[3].num    = '4';
-  produits[3].nbComp = 2;
-  sprintf(produits[3].ops, "461");
-  produits[3].etat   = 0;
+  futex(&__anneau->generation, FUTEX_WAKE, INT_MAX, NULL);
   
-  return produits;
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid != 0 && __atomic_load_n(&__abonnes[i].reveil, __ATOMIC_ACQUIRE) == g) {
+      futex(&__abonnes[i].reveil, FUTEX_WAKE, 1, NULL);
+    }
+  }
+}
+
+/**
+ * Attend au plus delai ms que le mot futex quitte la génération derniere
+ * et retourne la génération courante (derniere si le délai a expiré)
+ */
+unsigned int anneau_attendre_rotation(unsigned int *mot, unsigned int derniere, int delai) {
+  // Pas de variables statiques: les threads du serveur attendent chacun leur anneau
+  struct timespec t;
+  unsigned int g;
+  
+  t.tv_sec  = delai / 1000;
+  t.tv_nsec = (delai % 1000) * 1000000L;
+  
+  // EAGAIN: le mot a changé entre la lecture et l'appel; ETIMEDOUT: délai expiré
+  if ((g = __atomic_load_n(mot, __ATOMIC_ACQUIRE)) == derniere) {
+    futex(mot, FUTEX_WAIT, derniere, &t);
+    g = __atomic_load_n(mot, __ATOMIC_ACQUIRE);
+  }
+  
+  return g;
+}
+
+/**
+ * Signale à l'anneau la fin du traitement de la génération g
+ * L'anneau attend les acquittements en mode libre (anneau_relayer_rotation()) et, avec
+ * une cadence, dans la barrière de fin de rotation (anneau_barriere()), où il lève
+ * Anneau.barriere le temps de l'attente: l'abonné publie son acquittement, incrémente
+ * Anneau.acquittements, puis ne réveille l'anneau que s'il le voit en attente
+ */
+void anneau_acquitter(unsigned int *mot, unsigned int g) {
+  __atomic_store_n(mot, g, __ATOMIC_RELEASE);
+  
+  // Ordre total avec anneau_barriere(): l'anneau voit l'acquittement, ou l'abonné voit l'anneau en attente
+  __atomic_add_fetch(&__anneau->acquittements, 1, __ATOMIC_SEQ_CST);
+  if (__anneau->libre || __atomic_load_n(&__anneau->barriere, __ATOMIC_SEQ_CST)) {
+    futex(&__anneau->acquittements, FUTEX_WAKE, 1, NULL);
+  }
+}
+
+/**
+ * Mode libre: attend que le processus *pid ait acquitté la génération g dans mot
+ * Un processus disparu sans se désabonner, ou dont le coordinateur a repris
+ * l'abonnement (*pid modifié), n'est plus attendu
+ */
+static void anneau_attendre_acquittement(unsigned int *mot, unsigned int g, pid_t *pid) {
+  static struct timespec t = {0, DELAI_SIGNAUX_MS * 1000000L};
+  static unsigned int n;
+  static pid_t attendu;
+  
+  attendu = *pid;
+  
+  while (1) {
+    // Lecture du compteur avant le test: un acquittement entre les deux fait échouer FUTEX_WAIT
+    n = __atomic_load_n(&__anneau->acquittements, __ATOMIC_ACQUIRE);
+    
+    if (__atomic_load_n(mot, __ATOMIC_ACQUIRE) == g) {
+      return;
+    }
+    
+    if (futex(&__anneau->acquittements, FUTEX_WAIT, n, &t) == -1 && errno == ETIMEDOUT
+      && (__atomic_load_n(pid, __ATOMIC_ACQUIRE) != attendu || (kill(attendu, 0) == -1 && errno == ESRCH))) {
+      return;
+    }
+  }
+}
+
+/**
+ * Génération g acquittée par le serveur et par chaque robot qui en a été notifié, hors robots
+ * en retard (anneau_retarder()): un robot en retard qui acquitte g est de nouveau attendu
+ */
+static bool anneau_acquittee(unsigned int g) {
+  static Abonne *a;
+  static int i;
+  
+  if (__connexions[ANNEAU_POS_SERV_OUT] != 0 && __atomic_load_n(&__anneau->acquitteServeur, __ATOMIC_ACQUIRE) != g) {
+    return false;
+  }
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    if (a->pid == 0 || a->reveil != g) {
+      continue;
+    }
+    if (__atomic_load_n(&a->acquitte, __ATOMIC_ACQUIRE) == g) {
+      a->retarde = false;
+    } else if (!a->retarde) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Barrière de fin de rotation (cadence fixe ou adaptative): attend jusqu'à la date echeance
+ * que le serveur et les robots notifiés aient acquitté la génération g
+ * Aucun appel système si tous ont déjà acquitté; un abonné disparu ou gelé retient
+ * l'anneau jusqu'à l'échéance, puis n'est plus attendu une fois marqué en retard
+ * Retourne true si tous l'ont acquittée
+ */
+bool anneau_barriere(unsigned int g, unsigned long long echeance) {
+  static struct timespec t;
+  static unsigned long long maintenant;
+  static unsigned int n;
+  static bool acquittee;
+  
+  __atomic_store_n(&__anneau->barriere, 1, __ATOMIC_SEQ_CST);
+  
+  while (1) {
+    // Lecture du compteur avant le test: un acquittement entre les deux fait échouer FUTEX_WAIT
+    n = __atomic_load_n(&__anneau->acquittements, __ATOMIC_SEQ_CST);
+    
+    if ((acquittee = anneau_acquittee(g)) || (maintenant = horloge()) >= echeance) {
+      break;
+    }
+    
+    t.tv_sec  = (echeance - maintenant) / 1000000000ULL;
+    t.tv_nsec = (echeance - maintenant) % 1000000000ULL;
+    futex(&__anneau->acquittements, FUTEX_WAIT, n, &t);
+  }
+  
+  __atomic_store_n(&__anneau->barriere, 0, __ATOMIC_RELEASE);
+  return acquittee;
+}
+
+/**
+ * Barrière manquée: les robots notifiés qui n'ont pas acquitté la génération g ne sont plus
+ * attendus par anneau_barriere() jusqu'à ce qu'ils acquittent une rotation à temps
+ * Retourne le nombre de robots concernés
+ */
+int anneau_retarder(unsigned int g) {
+  static Abonne *a;
+  static int i, n;
+  
+  for (i = 0, n = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    if (a->pid != 0 && a->reveil == g && !a->retarde && __atomic_load_n(&a->acquitte, __ATOMIC_ACQUIRE) != g) {
+      a->retarde = true;
+      n++;
+    }
+  }
+  return n;
+}
+
+/**
+ * Mode libre: transmet la génération g au serveur, puis un par un, dans l'ordre
+ * des abonnements, aux robots marqués, en attendant que chacun l'ait traitée.
+ * L'ordre de traitement d'une rotation est ainsi fixé: deux exécutions de la
+ * même configuration donnent le même résultat, celui de la simulation
+ */
+void anneau_relayer_rotation(unsigned int g) {
+  static int i;
+  static Abonne *a;
+  
+  futex(&__anneau->generation, FUTEX_WAKE, INT_MAX, NULL);
+  
+  if (__connexions[ANNEAU_POS_SERV_OUT] != 0) {
+    anneau_attendre_acquittement(&__anneau->acquitteServeur, g, &__connexions[ANNEAU_POS_SERV_OUT]);
+  }
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    
+    if (a->pid != 0 && a->marque) {
+      a->marque = false;
+      __atomic_store_n(&anneau_dates(g)->diffusion, horloge(), __ATOMIC_RELEASE);
+      __atomic_store_n(&a->reveil, g, __ATOMIC_RELEASE);
+      futex(&a->reveil, FUTEX_WAKE, 1, NULL);
+      
+      anneau_attendre_acquittement(&a->acquitte, g, &a->pid);
+    }
+  }
+}
+
+/**
+ * Initialise les compteurs de l'anneau courant: tous nuls, cases comptées selon leur contenu
+ */
+void metriques_init() {
+  int i;
+  
+  memset(__metriques, 0, sizeof(Metriques));
+  memset(__metriquesRobots, 0, __anneau->nbRobots * sizeof(MetriquesRobot));
+  
+  for (i = 0; i < __anneau->nbCases; i++) {
+    __metriques->cases[__cases[i].type]++;
+  }
+}
+
+/**
+ * Compte le changement de contenu d'une case de l'anneau courant
+ * Les cases ne changent de contenu que sémaphore pris: les compteurs restent cohérents entre eux
+ */
+void metriques_case(TypeContenant avant, TypeContenant apres) {
+  if (avant != apres) {
+    METRIQUE_AJOUTER(__metriques->cases[avant], -1);
+    METRIQUE_AJOUTER(__metriques->cases[apres], 1);
+  }
+}
+
+/**
+ * Remet à zéro les compteurs de l'abonnement idx, à la connexion d'un robot
+ */
+void metriques_robot_init(int idx) {
+  memset(&__metriquesRobots[idx], 0, sizeof(MetriquesRobot));
+}
+
+/**
+ * Date courante en ns (CLOCK_MONOTONIC, commune aux processus)
+ */
+unsigned long long horloge() {
+  struct timespec t;
+  
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (unsigned long long) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+ * Ajoute la durée ns à l'histogramme h
+ * Classe: valeur exacte sous LATENCE_SOUS_CLASSES, sinon puissance de 2 et bits qui la suivent
+ * Variables locales: les threads du serveur mesurent chacun leur anneau
+ */
+void latence_ajouter(Histogramme *h, unsigned long long ns) {
+  int e, i;
+  
+  if (ns < LATENCE_SOUS_CLASSES) {
+    i = (int) ns;
+  } else {
+    e = 63 - __builtin_clzll(ns);
+    i = (e - LATENCE_PRECISION + 1) * LATENCE_SOUS_CLASSES + (int) ((ns >> (e - LATENCE_PRECISION)) & (LATENCE_SOUS_CLASSES - 1));
+    if (i >= LATENCE_CLASSES) {
+      i = LATENCE_CLASSES - 1;
+    }
+  }
+  
+  METRIQUE_AJOUTER(h->classes[i], 1);
+  METRIQUE_AJOUTER(h->nombre, 1);
+  if (ns > h->max) {
+    __atomic_store_n(&h->max, ns, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * Plus grande durée de la classe i
+ */
+static unsigned long long latence_borne(int i) {
+  int e;
+  
+  if (i < LATENCE_SOUS_CLASSES) {
+    return i;
+  }
+  e = i / LATENCE_SOUS_CLASSES + LATENCE_PRECISION - 1;
+  return ((unsigned long long) (LATENCE_SOUS_CLASSES + i % LATENCE_SOUS_CLASSES + 1) << (e - LATENCE_PRECISION)) - 1;
+}
+
+/**
+ * Durée en ns sous laquelle se trouvent centile % des mesures de h (borne haute de sa classe)
+ */
+unsigned long long latence_centile(Histogramme *h, double centile) {
+  unsigned long n, cumul;
+  int i;
+  
+  n = (unsigned long) (h->nombre * centile / 100.0 + 0.999999);
+  if (n == 0) {
+    return 0;
+  }
+  
+  for (i = 0, cumul = 0; i < LATENCE_CLASSES; i++) {
+    cumul += h->classes[i];
+    if (cumul >= n) {
+      return latence_borne(i) < h->max ? latence_borne(i) : h->max;
+    }
+  }
+  return h->max;
+}
+
+/**
+ * Dates de la rotation de génération g, parmi les ANNEAU_DATES dernières
+ */
+DatesRotation* anneau_dates(unsigned int g) {
+  return &(__anneau->dates[g & (ANNEAU_DATES - 1)]);
+}
+
+/**
+ * Abonné: entrée à la date t dans le traitement de la génération g
+ * Compte dans h le délai depuis la notification, même si l'anneau a tourné depuis:
+ * les réveils tardifs sont ceux qui importent. Au-delà de ANNEAU_RETARD_MESURE
+ * rotations, les dates de g peuvent être remplacées: le délai n'est plus connu
+ */
+void latence_reveil(Histogramme *h, unsigned int g, unsigned long long t) {
+  unsigned long long diffusion = __atomic_load_n(&anneau_dates(g)->diffusion, __ATOMIC_ACQUIRE);
+  
+  if (__atomic_load_n(&__anneau->generation, __ATOMIC_ACQUIRE) - g < ANNEAU_RETARD_MESURE && t >= diffusion) {
+    latence_ajouter(h, t - diffusion);
+  }
+}
+
+/**
+ * Abonné: fin à la date t du traitement de la génération g
+ * Repousse la fin de la rotation tant que l'anneau ne l'a pas mesurée (ANNEAU_RETARD_MESURE
+ * rotations plus tard): un traitement en retard allonge la durée de sa rotation. Plusieurs
+ * abonnés peuvent finir en même temps, le maximum est gardé par compare-and-swap
+ * Un traitement achevé après la rotation suivante est compté dans manquees
+ */
+void latence_fin(unsigned long *manquees, unsigned int g, unsigned long long t) {
+  unsigned long long *fin = &anneau_dates(g)->fin;
+  unsigned long long f = __atomic_load_n(fin, __ATOMIC_RELAXED);
+  unsigned int retard = __atomic_load_n(&__anneau->generation, __ATOMIC_ACQUIRE) - g;
+  
+  if (retard > 0) {
+    METRIQUE_AJOUTER(*manquees, 1);
+  }
+  
+  while (t > f && retard < ANNEAU_RETARD_MESURE
+	 && !__atomic_compare_exchange_n(fin, &f, t, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+  }
+}
+
+/**
+ * Affiche une ligne de centiles, en µs
+ */
+static void latence_ligne(const char *nom, Histogramme *h) {
+  if (h->nombre == 0) {
+    return;
+  }
+  printf("====== %-24s %9lu %9.1f %9.1f %9.1f %9.1f %9.1f\n", nom, h->nombre,
+	 latence_centile(h, 50) / 1e3, latence_centile(h, 90) / 1e3, latence_centile(h, 99) / 1e3,
+	 latence_centile(h, 99.9) / 1e3, h->max / 1e3);
+}
+
+/**
+ * Affiche les centiles des histogrammes de l'anneau courant: anneau, serveur,
+ * et chaque abonnement mesuré si robots
+ */
+void latences_afficher(bool robots) {
+  char nom[32];
+  int i;
+  
+  printf("==== Latences de l'anneau %d (µs)\n", __anneau->numero);
+  printf("====== %-24s %9s %9s %9s %9s %9s %9s\n", "", "mesures", "p50", "p90", "p99", "p99.9", "max");
+  
+  latence_ligne("rotation", &__metriques->rotation);
+  latence_ligne("attente anneau", &__metriques->attenteAnneau);
+  latence_ligne("notification serveur", &__metriques->reveilServeur);
+  latence_ligne("traitement serveur", &__metriques->traitementServeur);
+  latence_ligne("attente serveur", &__metriques->attenteServeur);
+  if (__metriques->manqueesServeur > 0) {
+    printf("====== Serveur: %lu rotations manquées (traitement achevé après la rotation suivante)\n", __metriques->manqueesServeur);
+  }
+  
+  for (i = 0; robots && i < __anneau->nbRobots; i++) {
+    if (__metriquesRobots[i].manquees > 0) {
+      printf("====== R%d: %lu rotations manquées (traitement achevé après la rotation suivante)\n", __abonnes[i].id, __metriquesRobots[i].manquees);
+    }
+    sprintf(nom, "notification R%d", __abonnes[i].id);
+    latence_ligne(nom, &__metriquesRobots[i].reveil);
+    sprintf(nom, "traitement R%d", __abonnes[i].id);
+    latence_ligne(nom, &__metriquesRobots[i].traitement);
+    sprintf(nom, "attente R%d", __abonnes[i].id);
+    latence_ligne(nom, &__metriquesRobots[i].attente);
+  }
+  
+  if (__anneau->cadence != ANNEAU_CADENCE_LIBRE) {
+    printf("====== Cadence %s%d ms, période %.1f µs: p99 de la rotation à %.1f %% de la période, %lu rotations achevées après la période\n",
+	   __anneau->adaptative ? "adaptative de " : "", __anneau->cadence, __anneau->periode / 1e3,
+	   latence_centile(&__metriques->rotation, 99) * 100.0 / __anneau->periode, __metriques->depassements);
+  }
+}
+
+/**
+ * Initialise le canal de contrôle: file des requêtes vide, boîtes libres
+ */
+void controle_init() {
+  int i;
+  
+  memset(__controle, 0, sizeof(Controle));
+  for (i = 0; i < CONTROLE_REQUETES; i++) {
+    __controle->cellules[i].sequence = i;
+  }
+  
+  memset(__boites, 0, __anneau->nbRobots * sizeof(BoiteControle));
+}
+
+/**
+ * Prend une boîte de réponse libre pour le processus pid
+ * Retourne son indice, -1 si toutes sont prises
+ */
+int controle_ouvrir_boite(pid_t pid) {
+  pid_t libre;
+  int b;
+  
+  for (b = 0; b < __anneau->nbRobots; b++) {
+    libre = 0;
+    if (__atomic_compare_exchange_n(&__boites[b].pid, &libre, pid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      // Réponses d'un précédent propriétaire ignorées
+      __boites[b].lues = __atomic_load_n(&__boites[b].ecrites, __ATOMIC_ACQUIRE);
+      return b;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Libère la boîte de réponse b
+ */
+void controle_fermer_boite(int b) {
+  __atomic_store_n(&__boites[b].pid, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Robot: dépose une requête pour le coordinateur et le réveille
+ * Attend une cellule libre si la file est pleine
+ */
+void controle_envoyer(RequeteControle *q) {
+  struct timespec t = {0, DELAI_SIGNAUX_MS * 1000000L};
+  CelluleControle *c;
+  unsigned int rang, sequence, retirees;
+  
+  rang = __atomic_load_n(&__controle->depot, __ATOMIC_RELAXED);
+  
+  while (1) {
+    c = &(__controle->cellules[rang % CONTROLE_REQUETES]);
+    sequence = __atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE);
+  
+    if (sequence == rang) {
+      // Cellule libre à ce rang: réservée si aucun autre robot ne l'a prise entre-temps
+      if (__atomic_compare_exchange_n(&__controle->depot, &rang, rang + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	break;
+      }
+    } else if ((int) (sequence - rang) < 0) {
+      // File pleine: attente d'un retrait du coordinateur
+      retirees = __atomic_load_n(&__controle->retirees, __ATOMIC_SEQ_CST);
+      __atomic_add_fetch(&__controle->robotsEnAttente, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&c->sequence, __ATOMIC_SEQ_CST) == sequence) {
+	futex(&__controle->retirees, FUTEX_WAIT, retirees, &t);
+      }
+      __atomic_sub_fetch(&__controle->robotsEnAttente, 1, __ATOMIC_SEQ_CST);
+      rang = __atomic_load_n(&__controle->depot, __ATOMIC_RELAXED);
+    } else {
+      rang = __atomic_load_n(&__controle->depot, __ATOMIC_RELAXED);
+    }
+  }
+  
+  c->requete = *q;
+  __atomic_store_n(&c->sequence, rang + 1, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&__controle->publiees, 1, __ATOMIC_SEQ_CST);
+  
+  if (__atomic_load_n(&__controle->coordinateurEnAttente, __ATOMIC_SEQ_CST)) {
+    futex(&__controle->publiees, FUTEX_WAKE, 1, NULL);
+  }
+}
+
+/**
+ * Coordinateur: retire la prochaine requête, en l'attendant au plus delai ms
+ * Retourne false si aucune requête n'est arrivée
+ */
+bool controle_recevoir(RequeteControle *q, int delai) {
+  struct timespec t = {delai / 1000, (delai % 1000) * 1000000L};
+  CelluleControle *c;
+  unsigned int rang, publiees;
+  
+  rang = __controle->retrait;
+  c = &(__controle->cellules[rang % CONTROLE_REQUETES]);
+  
+  if (__atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE) != rang + 1) {
+    if (delai == 0) {
+      return false;
+    }
+  
+    // Attente annoncée avant le dernier test; lecture du compteur avant ce test:
+    // une publication entre les deux fait échouer FUTEX_WAIT
+    publiees = __atomic_load_n(&__controle->publiees, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&__controle->coordinateurEnAttente, 1, __ATOMIC_SEQ_CST);
+  
+    if (__atomic_load_n(&c->sequence, __ATOMIC_SEQ_CST) != rang + 1) {
+      futex(&__controle->publiees, FUTEX_WAIT, publiees, &t);
+    }
+    __atomic_store_n(&__controle->coordinateurEnAttente, 0, __ATOMIC_RELAXED);
+  
+    if (__atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE) != rang + 1) {
+      return false;
+    }
+  }
+  
+  *q = c->requete;
+  __atomic_store_n(&c->sequence, rang + CONTROLE_REQUETES, __ATOMIC_SEQ_CST);
+  __controle->retrait = rang + 1;
+  __atomic_add_fetch(&__controle->retirees, 1, __ATOMIC_SEQ_CST);
+  
+  if (__atomic_load_n(&__controle->robotsEnAttente, __ATOMIC_SEQ_CST)) {
+    futex(&__controle->retirees, FUTEX_WAKE, INT_MAX, NULL);
+  }
+  
+  return true;
+}
+
+/**
+ * Coordinateur: écrit une réponse dans la boîte b et réveille le robot
+ * Retourne false si la boîte est pleine
+ */
+bool controle_repondre(int b, ReponseControle *r) {
+  BoiteControle *boite = &(__boites[b]);
+  unsigned int n = boite->ecrites;
+  
+  if (n - __atomic_load_n(&boite->lues, __ATOMIC_ACQUIRE) >= CONTROLE_REPONSES) {
+    return false;
+  }
+  
+  boite->reponses[n % CONTROLE_REPONSES] = *r;
+  __atomic_store_n(&boite->ecrites, n + 1, __ATOMIC_SEQ_CST);
+  
+  if (__atomic_load_n(&boite->robotEnAttente, __ATOMIC_SEQ_CST)) {
+    futex(&boite->ecrites, FUTEX_WAKE, 1, NULL);
+  }
+  
+  return true;
+}
+
+/**
+ * Robot: lit la prochaine réponse de la boîte b, en l'attendant au plus delai ms
+ * Retourne false si aucune réponse n'est arrivée
+ */
+bool controle_attendre_reponse(int b, ReponseControle *r, int delai) {
+  struct timespec t = {delai / 1000, (delai % 1000) * 1000000L};
+  BoiteControle *boite = &(__boites[b]);
+  unsigned int n = boite->lues;
+  
+  if (__atomic_load_n(&boite->ecrites, __ATOMIC_ACQUIRE) == n) {
+    if (delai == 0) {
+      return false;
+    }
+  
+    __atomic_store_n(&boite->robotEnAttente, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&boite->ecrites, __ATOMIC_SEQ_CST) == n) {
+      futex(&boite->ecrites, FUTEX_WAIT, n, &t);
+    }
+    __atomic_store_n(&boite->robotEnAttente, 0, __ATOMIC_RELAXED);
+  
+    if (__atomic_load_n(&boite->ecrites, __ATOMIC_ACQUIRE) == n) {
+      return false;
+    }
+  }
+  
+  *r = boite->reponses[n % CONTROLE_REPONSES];
+  __atomic_store_n(&boite->lues, n + 1, __ATOMIC_RELEASE);
+  
+  return true;
+}
+
+/**
+ * Enregistre le début du traitement de la génération g,
+ * reçue comme notification numéro n
+ */
+void cadencement_enregistrer(Cadencement *c, unsigned int g, unsigned int n) {
+  if (n - c->notifications > 1) {
+    c->manques += n - c->notifications - 1;
+  }
+  
+  c->notifications = n;
+  c->derniere = g;
+  c->traites++;
+  
+  c->retard = __atomic_load_n(&__anneau->generation, __ATOMIC_ACQUIRE) - g;
+  if (c->retard > c->retardMax) {
+    c->retardMax = c->retard;
+  }
+}
+
+/**
+ * Définit si l'intérêt it couvre le contenu de la case c
+ */
+bool interet_case(Interet *it, Case *c) {
+  switch (c->type) {
+    case VIDE:
+      return it->vide;
+      
+    case COMPOSANT:
+      return (it->composants >> (c->c.num - 1)) & 1;
+      
+    case PRODUIT:
+      if (c->p.etat < 0) {
+	return false;
+      }
+      return (it->produits[c->p.num - 1] >> c->p.ops[c->p.etat]) & 1;
+  }
+  return true;
+}
+
+/**
+ * Intérêt pour tout contenu: le robot est réveillé à chaque rotation
+ */
+void interet_tout(Interet *it) {
+  static int i;
+  
+  it->vide = true;
+  it->composants = ~0u;
+  
+  for (i = 0; i < NB_PROD_MAX; i++) {
+    it->produits[i] = ~0u;
+  }
+}
+
+/**
+ * Lit une liste de numéros entre 1 et max dans liste (terminée par 0)
+ * "1,2,10": numéros séparés par des virgules; "125": si compacte, un chiffre
+ * par numéro (notation de install.sh, 0 ignoré), sinon un seul numéro
+ * Retourne le nombre de numéros, -1 si la liste est invalide
+ */
+int lire_liste(const char *texte, char *liste, int taille, int max, bool compacte) {
+  bool virgules = !compacte || strchr(texte, ',') != NULL;
+  char *fin;
+  long num;
+  int n = 0;
+  
+  while (*texte) {
+    if (virgules) {
+      num = strtol(texte, &fin, 10);
+      if (fin == texte || (*fin != ',' && *fin != '\0')) {
+	return -1;
+      }
+      texte = *fin == ',' ? fin + 1 : fin;
+    } else {
+      // Notation compacte de install.sh: un chiffre par numéro
+      if (*texte < '0' || *texte > '9') {
+	return -1;
+      }
+      num = *texte++ - '0';
+    }
+  
+    if (num == 0) {
+      continue;
+    }
+    if (num < 0 || num > max || n == taille - 1) {
+      return -1;
+    }
+    liste[n++] = (char) num;
+  }
+  
+  liste[n] = 0;
+  return n;
+}
+
+/**
+ * Charge le fichier de recettes: une ligne par produit, numérotés à partir de 1
+ *   <produit> <composants> <opérations> <planifiés>
+ * Retourne le nombre de produits
+ */
+int lire_recettes(const char *fichier, Produit *produits, int *plan) {
+  char ligne[RECETTES_LIGNE], ops[RECETTES_LIGNE];
+  int num, n, nbProd = 0;
+  Produit *p;
+  FILE *f;
+  
+  if ((f = fopen(fichier, "r")) == NULL) {
+    __raise(-5, "======== ERROR: Recettes %s: %s", fichier, strerror(errno));
+  }
+  
+  for (n = 1; fgets(ligne, sizeof(ligne), f); n++) {
+    if (ligne[strspn(ligne, " \t\r\n")] == '\0' || ligne[strspn(ligne, " \t")] == '#') {
+      continue;
+    }
+  
+    if (nbProd == NB_PROD_MAX) {
+      __raise(-5, "======== ERROR: Recettes %s: %d produits au plus", fichier, NB_PROD_MAX);
+    }
+  
+    p = &produits[nbProd];
+  
+    if (sscanf(ligne, "%d %d %255s %d", &num, &p->nbComp, ops, &plan[nbProd]) != 4
+      || num != nbProd + 1 || p->nbComp < 1 || p->nbComp > NB_COMP_MAX || plan[nbProd] < 0
+      || (p->nbOps = lire_liste(ops, p->ops, sizeof(p->ops), NB_OPS_MAX, false)) < 1) {
+      __raise(-5, "======== ERROR: Recettes %s, ligne %d: attendu <produit %d> <composants 1..%d> <opérations> <planifiés>", fichier, n, nbProd + 1, NB_COMP_MAX);
+    }
+  
+    p->num  = nbProd + 1;
+    p->id   = 0;
+    p->etat = 0;
+    nbProd++;
+  }
+  
+  fclose(f);
+  
+  if (nbProd == 0) {
+    __raise(-5, "======== ERROR: Recettes %s: aucun produit", fichier);
+  }
+  return nbProd;
+}
+
+/**
+ * Copie les recettes et le plan dans les tableaux du segment
+ */
+void anneau_recettes(const Produit *produits, const int *plan) {
+  memcpy(__produits, produits, __anneau->nbProd * sizeof(Produit));
+  memcpy(__plan, plan, __anneau->nbProd * sizeof(int));
+}
+
+/**
+ * Lit l'entier décimal texte dans *valeur
+ * Retourne false s'il est vide, suivi d'autres caractères ou hors des valeurs d'un int
+ */
+bool lire_entier(const char *texte, int *valeur) {
+  char *fin;
+  long n;
+  
+  errno = 0;
+  n = strtol(texte, &fin, 10);
+  if (fin == texte || *fin != '\0' || errno != 0 || n < INT_MIN || n > INT_MAX) {
+    return false;
+  }
+  *valeur = (int) n;
+  return true;
+}
+
+/**
+ * Extrait l'option entière <prefixe><valeur> de la ligne de commande
+ * et retourne le nombre d'arguments restants; arrête le processus si la valeur n'est pas un entier
+ */
+int lire_option_entier(int argc, char **argv, const char *prefixe, int *valeur) {
+  int i, n;
+  
+  for (i = 1, n = 1; i < argc; i++) {
+    if (strncmp(argv[i], prefixe, strlen(prefixe)) == 0) {
+      if (!lire_entier(argv[i] + strlen(prefixe), valeur)) {
+	__raise(-1, "Option %s: entier attendu", argv[i]);
+      }
+    } else {
+      argv[n++] = argv[i];
+    }
+  }
+  
+  argv[n] = NULL;
+  return n;
+}
+
+/**
+ * Extrait l'option <prefixe><texte> de la ligne de commande
+ * et retourne le nombre d'arguments restants
+ */
+int lire_option_chaine(int argc, char **argv, const char *prefixe, char **valeur) {
+  int i, n;
+  
+  for (i = 1, n = 1; i < argc; i++) {
+    if (strncmp(argv[i], prefixe, strlen(prefixe)) == 0) {
+      *valeur = argv[i] + strlen(prefixe);
+    } else {
+      argv[n++] = argv[i];
+    }
+  }
+  
+  argv[n] = NULL;
+  return n;
 }
 
 /**
@@ -116,11 +1097,11 @@ void __end_process() {
 int __raise (int exitCode, const char *format, ...) {
   va_list arg;
   int done;
-
+  
   va_start (arg, format);
   done = vfprintf (stderr, format, arg);
   va_end (arg);
-
+  
   fprintf(stderr, "\n==\n== Exécution avortée avec le code d'erreur %d\n", exitCode);
   __end_process();
   
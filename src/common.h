@@ -3,7 +3,6 @@
 
 #include <sys/types.h>
 #include <sys/ipc.h>
-#include <sys/msg.h>
 #include <sys/shm.h>
 #include <sys/stat.h>   // For mode constants
 
@@ -14,25 +13,61 @@
 
 #include <fcntl.h>      // For O_* constants
 #include <semaphore.h>
+#include <string.h>
 
-#define ANNEAU_SHM_KEY		1266
-#define ANNEAU_SHM_SIZE		65536
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>	// Notification des rotations
+#include <time.h>		// Mesure des latences
 
-#define ANNEAU_NUM_CASES	16
+#define ANNEAU_SHM_KEY		1266	// Clé du premier anneau: ANNEAU_SHM_KEY + numéro pour les suivants
+
+#define ANNEAU_NUM_CASES	16	// Nombre de cases par défaut (option --cases de l'anneau)
 #define ANNEAU_CADENCE_DEFAULT  2000
+#define ANNEAU_CADENCE_LIBRE	0	// Cadence 0: rotation dès que les abonnés ont traité la précédente
+#define ANNEAU_BARRIERE_MS	1000	// Attente max des acquittements en retard, au-delà de la période (robot gelé)
+#define ADAPTATIVE_FENETRE	64	// Cadence adaptative: rotations entre deux réductions de la période
+#define ADAPTATIVE_MARGE	1.25	// Période visée: p99 de la fin des traitements de la fenêtre, plus 25 %
+#define ADAPTATIVE_MIN_US	200	// Période minimale, en µs
 #define ANNEAU_POS_SERV_OUT	0
-#define ANNEAU_POS_SERV_IN	ANNEAU_NUM_CASES - 1
+#define ANNEAU_POS_SERV_IN	(__anneau->nbCases - 1)
+
+#define COORD_MSG_HELLO		1	// Connexion: abonnement et position attribués
+#define COORD_MSG_GOODBYE	2	// Déconnexion, sans réponse
+#define COORD_MSG_INFO		3	// Abonnement et position courants du robot
+#define COORD_MSG_PING		4	// Le coordinateur est-il à l'écoute ?
+
+#define CONTROLE_REQUETES	64	// File des requêtes au coordinateur (puissance de 2)
+#define CONTROLE_REPONSES	4	// File des réponses de chaque boîte (puissance de 2)
 
-#define COORD_MSG_HELLO		1
-#define COORD_MSG_GOODBYE	2
-#define COORD_MSG_INFO		3
-#define COORD_MSG_PING		4
+#define NB_ANNEAUX_MAX		8	// Anneaux d'une ligne (option --anneau du processus anneau: 0..7)
 
-#define NB_ROBOTS		6
+#define NB_ROBOTS		6	// Capacité en robots par défaut (option --robots de l'anneau)
 #define NB_OPS			NB_ROBOTS
-#define NB_PROD			4
+#define NB_OPS_MAX		31	// Numéro d'opération max: les intérêts sont des masques 32 bits
+#define NB_PROD_MAX		32	// Nombre de produits max: taille des tableaux de stock
+#define NB_COMP_MAX		3	// Composants d'un produit au plus
+
+#define RECETTES_FICHIER	"recettes.conf"	// Recettes et plan de production par défaut (option --recettes=)
+#define RECETTES_LIGNE		256
+
+#define SEM_NAME		"/semaphore_anneau"	// Premier anneau; suivi de _<numéro> pour les suivants
+
+#define DESC_TAMPONS		4	// Descriptions utilisables simultanément (ex: dans un même printf)
+#define DESC_TAILLE		32
 
-#define SEM_NAME		"/semaphore_anneau"
+#define DELAI_SIGNAUX_MS	100	// Attente max d'une rotation avant de traiter les signaux en attente
+
+#define LATENCE_PRECISION	4	// Histogrammes de latence: 2^4 classes par puissance de 2, 1/16 de précision
+#define LATENCE_SOUS_CLASSES	(1 << LATENCE_PRECISION)
+#define LATENCE_CLASSES		(33 * LATENCE_SOUS_CLASSES)	// Durées jusqu'à 2^36 ns (69 s), au-delà dans la dernière classe
+
+#define ANNEAU_DATES		16	// Dates des dernières rotations gardées dans l'en-tête (puissance de 2)
+#define ANNEAU_RETARD_MESURE	8	// Une rotation est mesurée 8 rotations plus tard: traitements en retard compris
+
+#define METRIQUE_AJOUTER(compteur, n)	__atomic_fetch_add(&(compteur), (n), __ATOMIC_RELAXED)	// Compteurs partagés: incrément sans verrou ni ordre
 
 #define bool int
 #define true 1
@@ -52,29 +87,36 @@ typedef struct {
   int id;
   pid_t pid;
   int pos;
+  int idx;	// Indice d'abonnement aux rotations (Anneau.abonnes)
+  int anneau;	// Numéro de l'anneau auquel le robot est relié (option --anneau)
   Mode mode;
-  char ops[NB_OPS];
-  char prods[NB_PROD];
-  char prodsDegrades[NB_PROD];
-  int stockComposants[NB_PROD];
-  int stockProduits[NB_PROD];
+  char ops[NB_OPS_MAX + 1];		// Numéros d'opérations, terminés par 0 (voir lire_liste())
+  char prods[NB_PROD_MAX + 1];		// Numéros de produits, terminés par 0
+  char prodsDegrades[NB_PROD_MAX + 1];
+  int stockComposants[NB_PROD_MAX];
+  int stockProduits[NB_PROD_MAX];
 } Robot;
 
 /**
  * Structure Composant
  */
 typedef struct {
-  char num;
+  char num;	// Numéro du produit auquel le composant est destiné (1..nbProd)
+  int id;	// Numéro de série attribué à l'injection par le serveur
+  unsigned int injection;	// Génération de l'injection
 } Composant;
 
 /**
  * Structure Produit
  */
 typedef struct {
-  char num;// Type du composant nécessaire: correspond au numéro du composant
+  char num;	// Numéro du produit (1..nbProd): correspond au numéro du composant
+  int id;	// Numéro de série: celui du composant qui a complété le produit
+  unsigned int injection;	// Génération de l'injection de ce composant
   int nbComp;	// Nombre de composants nécessaires
-  char ops[NB_OPS + 1];	// Tableau de bits d'opérations nécessaires
-  int etat;	// Numéro de l'opération en attente. varie entre {1..6}. -1 = Produit terminé
+  int nbOps;	// Nombre d'opérations de la gamme
+  char ops[NB_OPS_MAX + 1];	// Gamme: numéros d'opérations (1..NB_OPS_MAX), terminée par 0
+  int etat;	// Indice de l'opération en attente dans ops. -1 = Produit terminé
 } Produit;
 
 /**
@@ -96,69 +138,255 @@ typedef struct {
   TypeContenant type;
 } Case;
 
+/**
+ * Structure Interet: contenus de case sur lesquels un robot peut agir
+ * Publiée par le robot après chaque traitement, testée par l'anneau à chaque rotation
+ */
+typedef struct {
+  bool vide;			// Case VIDE: le robot a du stock à poser sur l'anneau
+  unsigned int composants;	// Bit i: composant C(i+1) accepté
+  unsigned int produits[NB_PROD_MAX];	// Bit o de produits[i]: P(i+1) en attente de l'opération o accepté
+} Interet;
+
+/**
+ * Structure Abonne: inscription d'un robot aux rotations de l'anneau
+ */
+typedef struct {
+  pid_t pid;			// 0 = entrée libre
+  int pos;
+  Interet interet;
+  unsigned int reveil;		// Mot futex: dernière génération notifiée au robot
+  unsigned int notifications;	// Nombre de rotations notifiées au robot
+  unsigned int acquitte;	// Dernière génération traitée par le robot
+  bool marque;			// Mode libre: robot concerné par la rotation en cours
+  bool retarde;			// Cadence: acquittement manqué, plus attendu par la barrière avant d'avoir rattrapé l'anneau
+  int id;			// Robot abonné et ses capacités, pour le placement
+  unsigned int masqueOps;	// Bit o: opération o réalisable
+  unsigned int masqueProds;	// Rôle en mode normal, bit i: produit i+1 accepté
+  int op;			// Rôle en mode normal: opération effectuée sur les produits pris
+  unsigned int masqueDegrades;	// Bit i: produit i+1 accepté en mode dégradé
+  Mode mode;			// Mode du robot: basculé par SIGUSR2, ou imposé par le serveur
+  unsigned int composantsRefuses;	// Bit i: composants du produit i+1 regroupés chez un autre robot
+  unsigned int actions;		// Actions effectuées par le robot (prises et poses)
+  unsigned int actionsFenetre;	// Actions au début de la fenêtre de mesure du pilotage
+  unsigned int battement;	// Incrémenté à chaque tour de la boucle principale du robot
+  unsigned char stockComposants[NB_PROD_MAX];	// Stock local publié par le robot après chaque action:
+  unsigned char stockProduits[NB_PROD_MAX];	// repris par le coordinateur si le robot disparaît
+} Abonne;
+
+/**
+ * Structure Cadencement: suivi des rotations traitées par la boucle principale
+ */
+typedef struct {
+  unsigned int derniere;	// Dernière génération traitée
+  unsigned int notifications;	// Notifications reçues au dernier traitement
+  unsigned long traites;	// Rotations traitées
+  unsigned long manques;	// Rotations notifiées mais fusionnées pendant un traitement
+  unsigned int retard;		// Rotations effectuées depuis celle en cours de traitement
+  unsigned int retardMax;
+} Cadencement;
+
+/**
+ * Motifs de refus d'une prise par un robot (décision de puis_je_prendre_composant()
+ * et puis_je_prendre_produit())
+ */
+typedef enum {
+  REFUS_PRODUIT,	// Produit hors des produits du robot dans son mode
+  REFUS_REGROUPE,	// Composants regroupés chez un autre robot
+  REFUS_STOCK,		// Stock local plein
+  REFUS_OPERATION,	// Opération attendue non acceptée
+  REFUS_TERMINE,	// Produit terminé
+  NB_REFUS
+} MotifRefus;
+
+/**
+ * Structure Histogramme: durées en ns, classées comme HdrHistogram: valeurs exactes
+ * jusqu'à LATENCE_SOUS_CLASSES, puis LATENCE_SOUS_CLASSES classes égales par puissance de 2
+ * Un seul écrivain par histogramme
+ */
+typedef struct {
+  unsigned long nombre;
+  unsigned long max;
+  unsigned int classes[LATENCE_CLASSES];
+} Histogramme;
+
+/**
+ * Structure MetriquesRobot: compteurs d'un abonnement, en rotations
+ * occupe, bloque et refus sont écrits par le robot, inactif par l'anneau
+ */
+typedef struct {
+  unsigned long occupe;		// Rotations traitées avec une action
+  unsigned long bloque;		// Rotations traitées sans action possible
+  unsigned long inactif;	// Rotations où la case devant le robot ne le concernait pas
+  unsigned long refus[NB_REFUS];	// Prises refusées, par motif
+  Histogramme reveil;		// Notification de la rotation -> entrée dans le traitement
+  Histogramme traitement;	// Entrée -> sortie du traitement, attente du sémaphore comprise
+  Histogramme attente;		// Attente du sémaphore
+  unsigned long manquees;	// Traitements achevés après la rotation suivante
+} MetriquesRobot;
+
+/**
+ * Structure Metriques: compteurs de l'anneau, lus sans verrou par anneau-stat
+ * Mis à jour par incréments atomiques relâchés: aucun appel système, aucune attente
+ */
+typedef struct {
+  long cases[3];		// Cases par type de contenu (TypeContenant)
+  unsigned long injections[NB_PROD_MAX];	// Composants injectés, par produit
+  unsigned long expeditions[NB_PROD_MAX];	// Produits expédiés, par produit
+  unsigned long rotationsExpedies[NB_PROD_MAX];	// Rotations cumulées des produits expédiés, depuis l'injection de leur dernier composant
+  unsigned long depassements;	// Rotations achevées après la cadence
+  Histogramme rotation;		// Sémaphore pris par l'anneau -> fin du dernier traitement de la rotation
+  Histogramme attenteAnneau;	// Attente du sémaphore par l'anneau
+  Histogramme reveilServeur;	// Mêmes mesures que MetriquesRobot, pour le serveur
+  Histogramme traitementServeur;
+  Histogramme attenteServeur;
+  unsigned long manqueesServeur;
+} Metriques;
+
+/**
+ * Structure DatesRotation: dates en ns (CLOCK_MONOTONIC) d'une rotation
+ */
+typedef struct {
+  unsigned long long debut;	// Sémaphore pris par l'anneau
+  unsigned long long diffusion;	// Notification (en mode libre, celle du dernier abonné relayé)
+  unsigned long long fin;	// Fin du dernier traitement
+} DatesRotation;
+
+/**
+ * Structure Anneau: en-tête du segment partagé
+ * La géométrie est fixée par l'anneau à sa création; le segment contient à la suite:
+ *   Case   cases[nbCases]
+ *   pid_t  connexion[nbCases]
+ *   Abonne abonnes[nbRobots]
+ *   Produit produits[nbProd]	Recettes: profil de chaque produit à l'assemblage
+ *   int plan[nbProd]		Plan de production
+ *   Controle controle		Requêtes des robots au coordinateur
+ *   BoiteControle boites[nbRobots]	Réponses du coordinateur
+ *   Metriques metriques		Compteurs de l'anneau
+ *   MetriquesRobot metriquesRobots[nbRobots]	Compteurs de chaque abonnement
+ */
 typedef struct {
   int id;
-  Case cases[ANNEAU_NUM_CASES];
-  pid_t connexion[ANNEAU_NUM_CASES];
+  int numero;		// Numéro de l'anneau dans la ligne (option --anneau)
+  int nbCases;		// Nombre de cases
+  int nbRobots;		// Capacité en robots (entrées d'abonnement)
+  int nbProd;		// Nombre de produits (recettes chargées par l'anneau)
+  size_t taille;	// Taille totale du segment
+  int tete;	// Indice physique de la case en position logique 0
+  unsigned int generation;	// Numéro de rotation, sert aussi de mot futex aux abonnés
+  bool libre;			// Mode libre: l'anneau relaie chaque rotation aux abonnés un par un
+  unsigned int acquitteServeur;	// Dernière génération traitée par le serveur
+  unsigned int acquittements;	// Mot futex de l'anneau: incrémenté à chaque acquittement
+  int barriere;			// L'anneau attend des acquittements: les abonnés le réveillent
+  int cadence;			// En ms, ANNEAU_CADENCE_LIBRE en mode libre; période maximale en cadence adaptative
+  bool adaptative;		// Période ajustée aux traitements (option --adaptative)
+  unsigned long long periode;	// Période courante en ns
+  DatesRotation dates[ANNEAU_DATES];	// Dates des dernières rotations, par génération (anneau_dates())
 } Anneau;
 
 /**
- * Structure SignalSonore: Utilisée pour l'envoie de la requête sur la file de message
+ * Structure RequeteControle: message d'un robot au coordinateur
  */
 typedef struct {
-  long  type;
-} SignalSonore;
+  int type;	// COORD_MSG_*
+  int boite;	// Boîte de réponse du robot (Anneau: boites[])
+  Robot bot;
+} RequeteControle;
 
+/**
+ * Structure ReponseControle: réponse du coordinateur dans la boîte du robot
+ */
+typedef struct {
+  int type;	// COORD_MSG_* de la requête
+  int pos;	// Position attribuée, -1 si aucune
+  int idx;	// Indice d'abonnement, nbRobots si aucun n'est libre
+} ReponseControle;
 
 /**
- * Structure QueryConnexion: Utilisée pour l'envoie de la requête pour 
+ * Structure CelluleControle: cellule de la file des requêtes
+ * sequence == rang de dépôt: libre; rang + 1: requête publiée, lisible par le coordinateur
  */
 typedef struct {
-  long  type;
-  Robot bot;
-  int query;
-} QueryConnexion;
+  unsigned int sequence;
+  RequeteControle requete;
+} CelluleControle;
 
 /**
- * Structure QueryConnexion: Utilisée pour l'envoie de la requête pour 
+ * Structure Controle: file des requêtes au coordinateur, dans le segment partagé
+ * Plusieurs robots déposent (réservation d'une cellule par compare-and-swap), le seul
+ * coordinateur retire: aucun appel système tant que personne n'attend
  */
 typedef struct {
-  long  type;
-  int pos;
-} QueryConnexionResponse;
+  unsigned int depot;		// Rang de la prochaine cellule réservée par un robot
+  unsigned int retrait;		// Rang de la prochaine cellule lue par le coordinateur
+  unsigned int publiees;	// Mot futex du coordinateur: requêtes publiées
+  unsigned int retirees;	// Mot futex des robots qui attendent une cellule libre
+  int coordinateurEnAttente;	// Réveils seulement si quelqu'un attend: sinon aucun appel système
+  int robotsEnAttente;
+  CelluleControle cellules[CONTROLE_REQUETES];
+} Controle;
 
 /**
- * Structure QueryConnexion: Utilisée pour l'envoie de la requête pour 
+ * Structure BoiteControle: réponses du coordinateur à un robot
+ * Un seul écrivain (le coordinateur), un seul lecteur (le robot qui a pris la boîte)
  */
 typedef struct {
-  long  type;
-  int query;
-} QueryPing;
+  pid_t pid;			// 0 = boîte libre
+  unsigned int ecrites;		// Mot futex du robot: réponses écrites
+  unsigned int lues;
+  int robotEnAttente;
+  ReponseControle reponses[CONTROLE_REPONSES];
+} BoiteControle;
 
 /**
- * Structure QueryConnexion: Utilisée pour l'envoie de la requête pour 
+ * Structure VueAnneau: adresses d'un anneau attaché, pour les processus reliés à
+ * plusieurs anneaux (serveur, simulation): anneau_selectionner() en fait l'anneau courant
  */
 typedef struct {
-  long  type;
-  pid_t pid_bot;
-  int query;
-} QueryPingResponse;
+  int shmid;
+  Anneau *anneau;
+  sem_t *semaphore;
+  Case *cases;
+  pid_t *connexions;
+  Abonne *abonnes;
+  Produit *produits;
+  int *plan;
+  Controle *controle;
+  BoiteControle *boites;
+  Metriques *metriques;
+  MetriquesRobot *metriquesRobots;
+} VueAnneau;
 
 // // // // // // // // //
 // Global shared vars   //
 // // // // // // // // // 
 
 pid_t __pid;		// PID du processus
-int __shmid;
-Anneau *__anneau;		// Ressource critique
-sem_t *__semaphore;	// Sémaphore de synchronisation de l'anneau
+
+// Anneau courant: propre à chaque thread, les threads du serveur servent chacun un anneau
+__thread int __shmid;
+__thread Anneau *__anneau;		// Ressource critique
+__thread sem_t *__semaphore;	// Sémaphore de synchronisation de l'anneau
+
+__thread Case *__cases;		// Cases de l'anneau (indices physiques)
+__thread pid_t *__connexions;	// Processus connecté à chaque position
+__thread Abonne *__abonnes;	// Abonnements des robots aux rotations
+__thread Produit *__produits;	// Recettes, par numéro de produit - 1
+__thread int *__plan;		// Nombre de produits à fabriquer, par numéro de produit - 1
+__thread Controle *__controle;	// Requêtes des robots au coordinateur
+__thread BoiteControle *__boites;	// Réponses du coordinateur, une boîte par robot
+__thread Metriques *__metriques;	// Compteurs de l'anneau (anneau-stat)
+__thread MetriquesRobot *__metriquesRobots;	// Compteurs de chaque abonnement
 
 // // // // // // // //
 // Shared functions  //
 // // // // // // // // 
 
+#include "allocations.h"
+
 /**
  * Affiche la description d'un composant
+ * Les descriptions sont écrites dans DESC_TAMPONS tampons statiques utilisés tour à tour
  */
 char* desc_composant(Composant *c);
 
@@ -172,9 +400,246 @@ char* desc_produit(Produit *p);
  */
 char* desc_case(Case *c);
 
+/**
+ * Affiche une liste de numéros (opérations ou produits) sous la forme 1,2,5
+ */
+char* desc_liste(const char *liste);
+
+/**
+ * Taille du segment d'un anneau de nbCases cases, nbRobots robots et nbProd produits
+ */
+size_t anneau_taille(int nbCases, int nbRobots, int nbProd);
+
+/**
+ * Calcule l'adresse des tableaux qui suivent l'en-tête de l'anneau
+ */
+void anneau_geometrie();
+
+/**
+ * Clé du segment de l'anneau numero du projet
+ */
+key_t anneau_cle(char *projet, int numero);
+
+/**
+ * Nom du sémaphore de l'anneau numero
+ */
+char* anneau_nom_semaphore(int numero);
+
+/**
+ * Attache le segment de l'anneau numero en fonctionnement, ouvre son sémaphore et lit sa géométrie
+ */
+void anneau_attacher(char *projet, int numero);
+
+/**
+ * Mémorise dans v les adresses de l'anneau courant
+ */
+void anneau_memoriser(VueAnneau *v);
+
+/**
+ * Fait de l'anneau mémorisé dans v l'anneau courant du thread
+ */
+void anneau_selectionner(VueAnneau *v);
+
+/**
+ * Retourne la case située à la position logique pos de l'anneau
+ */
+Case* anneau_case(int pos);
+
+/**
+ * Position de connexion d'un nouveau robot
+ */
+int anneau_position_libre();
+
 int nb_cases_vides();
 
-Produit* init_produits();
+/**
+ * Avance la génération et marque les abonnés intéressés par la case devant eux
+ * Doit être appelée sémaphore pris, juste après la rotation
+ */
+unsigned int anneau_marquer_abonnes();
+
+/**
+ * Réveille les processus en attente de la génération g
+ */
+void anneau_diffuser_rotation(unsigned int g);
+
+/**
+ * Attend au plus delai ms que le mot futex quitte la génération derniere
+ * et retourne la génération courante (derniere si le délai a expiré)
+ */
+unsigned int anneau_attendre_rotation(unsigned int *mot, unsigned int derniere, int delai);
+
+/**
+ * Signale à l'anneau la fin du traitement de la génération g
+ */
+void anneau_acquitter(unsigned int *mot, unsigned int g);
+
+/**
+ * Barrière de fin de rotation (cadence fixe ou adaptative): attend jusqu'à la date echeance
+ * que le serveur et les robots notifiés aient acquitté la génération g
+ * Retourne true si tous l'ont acquittée
+ */
+bool anneau_barriere(unsigned int g, unsigned long long echeance);
+
+/**
+ * Barrière manquée: les robots qui n'ont pas acquitté la génération g ne sont plus attendus
+ * Retourne le nombre de robots concernés
+ */
+int anneau_retarder(unsigned int g);
+
+/**
+ * Mode libre: transmet la génération g au serveur, puis un par un, dans l'ordre
+ * des abonnements, aux robots marqués, en attendant que chacun l'ait traitée
+ */
+void anneau_relayer_rotation(unsigned int g);
+
+/**
+ * Initialise les compteurs de l'anneau courant: tous nuls, cases comptées selon leur contenu
+ */
+void metriques_init();
+
+/**
+ * Compte le changement de contenu d'une case de l'anneau courant
+ */
+void metriques_case(TypeContenant avant, TypeContenant apres);
+
+/**
+ * Remet à zéro les compteurs de l'abonnement idx, à la connexion d'un robot
+ */
+void metriques_robot_init(int idx);
+
+/**
+ * Date courante en ns (CLOCK_MONOTONIC, commune aux processus)
+ */
+unsigned long long horloge();
+
+/**
+ * Ajoute la durée ns à l'histogramme h
+ */
+void latence_ajouter(Histogramme *h, unsigned long long ns);
+
+/**
+ * Durée en ns sous laquelle se trouvent centile % des mesures de h (borne haute de sa classe)
+ */
+unsigned long long latence_centile(Histogramme *h, double centile);
+
+/**
+ * Dates de la rotation de génération g, parmi les ANNEAU_DATES dernières
+ */
+DatesRotation* anneau_dates(unsigned int g);
+
+/**
+ * Abonné: entrée à la date t dans le traitement de la génération g
+ * Compte dans h le délai depuis la notification, même si l'anneau a tourné depuis
+ */
+void latence_reveil(Histogramme *h, unsigned int g, unsigned long long t);
+
+/**
+ * Abonné: fin à la date t du traitement de la génération g
+ * Repousse la fin de la rotation tant qu'elle n'est pas mesurée; compte dans manquees
+ * un traitement achevé après la rotation suivante
+ */
+void latence_fin(unsigned long *manquees, unsigned int g, unsigned long long t);
+
+/**
+ * Affiche les centiles des histogrammes de l'anneau courant: anneau, serveur,
+ * et chaque abonnement mesuré si robots
+ */
+void latences_afficher(bool robots);
+
+/**
+ * Initialise le canal de contrôle: file des requêtes vide, boîtes libres
+ */
+void controle_init();
+
+/**
+ * Prend une boîte de réponse libre pour le processus pid
+ * Retourne son indice, -1 si toutes sont prises
+ */
+int controle_ouvrir_boite(pid_t pid);
+
+/**
+ * Libère la boîte de réponse b
+ */
+void controle_fermer_boite(int b);
+
+/**
+ * Robot: dépose une requête pour le coordinateur et le réveille
+ * Attend une cellule libre si la file est pleine
+ */
+void controle_envoyer(RequeteControle *q);
+
+/**
+ * Coordinateur: retire la prochaine requête, en l'attendant au plus delai ms
+ * Retourne false si aucune requête n'est arrivée
+ */
+bool controle_recevoir(RequeteControle *q, int delai);
+
+/**
+ * Coordinateur: écrit une réponse dans la boîte b et réveille le robot
+ * Retourne false si la boîte est pleine
+ */
+bool controle_repondre(int b, ReponseControle *r);
+
+/**
+ * Robot: lit la prochaine réponse de la boîte b, en l'attendant au plus delai ms
+ * Retourne false si aucune réponse n'est arrivée
+ */
+bool controle_attendre_reponse(int b, ReponseControle *r, int delai);
+
+/**
+ * Enregistre le début du traitement de la génération g,
+ * reçue comme notification numéro n
+ */
+void cadencement_enregistrer(Cadencement *c, unsigned int g, unsigned int n);
+
+/**
+ * Définit si l'intérêt it couvre le contenu de la case c
+ */
+bool interet_case(Interet *it, Case *c);
+
+/**
+ * Intérêt pour tout contenu: le robot est réveillé à chaque rotation
+ */
+void interet_tout(Interet *it);
+
+/**
+ * Lit une liste de numéros entre 1 et max dans liste (terminée par 0)
+ * "1,2,10": numéros séparés par des virgules; "125": si compacte, un chiffre
+ * par numéro (notation de install.sh, 0 ignoré), sinon un seul numéro
+ * Retourne le nombre de numéros, -1 si la liste est invalide
+ */
+int lire_liste(const char *texte, char *liste, int taille, int max, bool compacte);
+
+/**
+ * Charge le fichier de recettes: une ligne par produit, numérotés à partir de 1
+ *   <produit> <composants> <opérations> <planifiés>
+ * Retourne le nombre de produits
+ */
+int lire_recettes(const char *fichier, Produit *produits, int *plan);
+
+/**
+ * Copie les recettes et le plan dans les tableaux du segment
+ */
+void anneau_recettes(const Produit *produits, const int *plan);
+
+/**
+ * Lit l'entier décimal texte dans *valeur
+ * Retourne false s'il est vide, suivi d'autres caractères ou hors des valeurs d'un int
+ */
+bool lire_entier(const char *texte, int *valeur);
+
+/**
+ * Extrait l'option entière <prefixe><valeur> de la ligne de commande
+ * et retourne le nombre d'arguments restants; arrête le processus si la valeur n'est pas un entier
+ */
+int lire_option_entier(int argc, char **argv, const char *prefixe, int *valeur);
+
+/**
+ * Extrait l'option <prefixe><texte> de la ligne de commande
+ * et retourne le nombre d'arguments restants
+ */
+int lire_option_chaine(int argc, char **argv, const char *prefixe, char **valeur);
 
 /**
  * Marque la fin de l'exécution
@@ -0,0 +1,201 @@
+#include "journal.h"
+
+/**
+ * Tampon circulaire producteur unique (boucle principale) / consommateur unique (écrivain)
+ * Les indices ne font que croître: la case d'un indice est indice & (JOURNAL_TAILLE - 1)
+ */
+static Evenement tampon[JOURNAL_TAILLE];
+static unsigned int ecrits;	// Indice du prochain événement produit
+static unsigned int lus;	// Indice du prochain événement à écrire dans le fichier
+static unsigned long perdus;	// Événements perdus, tampon plein
+
+static int fd_journal = -1;
+static int acteur_journal;
+static int ecrivain_actif;
+static pthread_t ecrivain;
+
+/**
+ * Extrait les options --quiet et --log=<text|binary|trace> de la ligne de commande
+ * et retourne le nombre d'arguments restants
+ */
+int lire_options_sortie(int argc, char **argv) {
+  int i, n;
+
+  __sortie = SORTIE_TEXTE;
+
+  for (i = 1, n = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quiet") == 0) {
+      __sortie = SORTIE_SILENCE;
+    } else if (strcmp(argv[i], "--log=binary") == 0) {
+      __sortie = SORTIE_BINAIRE;
+    } else if (strcmp(argv[i], "--log=trace") == 0) {
+      __sortie = SORTIE_TRACE;
+    } else if (strcmp(argv[i], "--log=text") == 0) {
+      __sortie = SORTIE_TEXTE;
+    } else {
+      argv[n++] = argv[i];
+    }
+  }
+
+  argv[n] = NULL;
+  return n;
+}
+
+/**
+ * Écrit dans le fichier les événements disponibles, par lots contigus
+ * Retourne le nombre d'événements écrits
+ */
+static int journal_vider() {
+  unsigned int e, l, n;
+
+  e = __atomic_load_n(&ecrits, __ATOMIC_ACQUIRE);
+  l = lus;
+  n = e - l;
+
+  // Pas de retour au début du tampon dans un même lot
+  if (n > JOURNAL_TAILLE - (l & (JOURNAL_TAILLE - 1))) {
+    n = JOURNAL_TAILLE - (l & (JOURNAL_TAILLE - 1));
+  }
+  if (n > JOURNAL_LOT) {
+    n = JOURNAL_LOT;
+  }
+
+  if (n > 0) {
+    if (write(fd_journal, &tampon[l & (JOURNAL_TAILLE - 1)], n * sizeof(Evenement)) == -1) {
+      perror("journal");
+    }
+    __atomic_store_n(&lus, l + n, __ATOMIC_RELEASE);
+  }
+
+  return n;
+}
+
+/**
+ * Exécutée par le thread: Écrivain du journal
+ */
+static void* journal_ecrivain(void *arg) {
+  static struct timespec pause = {0, JOURNAL_PAUSE_MS * 1000000L};
+  sigset_t tous;
+  int fin;
+
+  (void) arg;
+
+  // Les signaux restent destinés à la boucle principale
+  sigfillset(&tous);
+  pthread_sigmask(SIG_BLOCK, &tous, NULL);
+
+  while (1) {
+    fin = !__atomic_load_n(&ecrivain_actif, __ATOMIC_ACQUIRE);
+
+    if (journal_vider() == 0) {
+      if (fin) {
+	break;
+      }
+      nanosleep(&pause, NULL);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Ouvre le journal du processus et démarre l'écrivain (modes SORTIE_BINAIRE et SORTIE_TRACE)
+ * Fichier: journal-<pid>.bin dans le répertoire courant
+ */
+void journal_ouvrir(int acteur) {
+  EnteteJournal entete;
+  char nom[64];
+
+  if (__sortie != SORTIE_BINAIRE && __sortie != SORTIE_TRACE) {
+    return;
+  }
+
+  acteur_journal = acteur;
+
+  sprintf(nom, "journal-%d.bin", (int) getpid());
+  if ((fd_journal = open(nom, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+    __raise(-5, "======== ERROR: Impossible de créer le journal %s", nom);
+  }
+
+  memcpy(entete.magique, JOURNAL_MAGIQUE, 4);
+  entete.acteur = acteur;
+  entete.pid    = getpid();
+  entete.nbCases = __anneau->nbCases;
+  if (write(fd_journal, &entete, sizeof(EnteteJournal)) == -1) {
+    __raise(-5, "======== ERROR: Écriture impossible dans le journal %s", nom);
+  }
+
+  __atomic_store_n(&ecrivain_actif, 1, __ATOMIC_RELEASE);
+  pthread_create(&ecrivain, NULL, journal_ecrivain, NULL);
+
+  printf("==== Journal binaire: %s\n", nom);
+}
+
+/**
+ * Enregistre un événement sans bloquer: l'événement est perdu si le tampon est plein
+ */
+void journal(TypeEvenement type, TypeContenant contenu, char num, char op, int pos, int etat, int id) {
+  static struct timespec t;
+  static Evenement *ev;
+  static unsigned int e;
+
+  if (fd_journal == -1) {
+    return;
+  }
+
+  e = ecrits;
+  if (e - __atomic_load_n(&lus, __ATOMIC_ACQUIRE) >= JOURNAL_TAILLE) {
+    perdus++;
+    return;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  ev = &tampon[e & (JOURNAL_TAILLE - 1)];
+  ev->date       = (unsigned long long) t.tv_sec * 1000000000ULL + t.tv_nsec;
+  ev->generation = __anneau->generation;
+  ev->type       = type;
+  ev->contenu    = contenu;
+  ev->num        = num;
+  ev->op         = op;
+  ev->pos        = pos;
+  ev->etat       = etat;
+  ev->acteur     = acteur_journal;
+  ev->id         = id;
+
+  __atomic_store_n(&ecrits, e + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Encadre le traitement d'une rotation (mode SORTIE_TRACE uniquement)
+ */
+void journal_debut() {
+  if (__sortie == SORTIE_TRACE) {
+    journal(EV_DEBUT, VIDE, 0, 0, -1, 0, 0);
+  }
+}
+
+void journal_fin() {
+  if (__sortie == SORTIE_TRACE) {
+    journal(EV_FIN, VIDE, 0, 0, -1, 0, 0);
+  }
+}
+
+/**
+ * Vide le tampon, arrête l'écrivain et ferme le journal
+ */
+void journal_fermer() {
+  if (fd_journal == -1) {
+    return;
+  }
+
+  __atomic_store_n(&ecrivain_actif, 0, __ATOMIC_RELEASE);
+  pthread_join(ecrivain, NULL);
+
+  close(fd_journal);
+  fd_journal = -1;
+
+  if (perdus > 0) {
+    fprintf(stderr, "====== Journal: %lu événements perdus (tampon plein)\n", perdus);
+  }
+}
@@ -0,0 +1,102 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/********************************/
+/* Journal binaire d'événements */
+/********************************/
+
+#include "common.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define JOURNAL_TAILLE		4096	// Capacité du tampon circulaire (puissance de 2)
+#define JOURNAL_LOT		256	// Nombre max d'événements écrits par appel à write()
+#define JOURNAL_PAUSE_MS	10	// Attente de l'écrivain quand le tampon est vide
+#define JOURNAL_MAGIQUE		"ANJ3"
+
+#define ACTEUR_ANNEAU		-1
+#define ACTEUR_SERVEUR		0
+
+/**
+ * Modes de sortie des processus
+ */
+typedef enum {
+  SORTIE_TEXTE,		// Tableaux de bord printf (par défaut)
+  SORTIE_BINAIRE,	// Journal binaire uniquement
+  SORTIE_TRACE,		// Journal binaire avec la durée de chaque traitement (export de trace)
+  SORTIE_SILENCE	// Aucune sortie par rotation
+} Sortie;
+
+/**
+ * Types d'événements
+ */
+typedef enum {
+  EV_ROTATION = 1,	// L'anneau a tourné d'un pas
+  EV_PRISE,		// Un robot a pris le contenu d'une case
+  EV_POSE,		// Un robot a posé un composant ou un produit sur une case
+  EV_OPERATION,		// Un robot a effectué une opération sur un produit
+  EV_EXPEDITION,	// Le serveur a récupéré un produit terminé
+  EV_INJECTION,		// Le serveur a injecté un composant
+  EV_ASSEMBLAGE,	// Un robot a réuni les composants d'un produit
+  EV_DEBUT,		// Début du traitement d'une rotation (SORTIE_TRACE)
+  EV_FIN		// Fin du traitement d'une rotation (SORTIE_TRACE)
+} TypeEvenement;
+
+/**
+ * Structure Evenement: enregistrement binaire de taille fixe
+ */
+typedef struct {
+  unsigned long long date;	// Date en ns (CLOCK_MONOTONIC, commune aux processus)
+  unsigned int generation;	// Rotation de l'anneau
+  unsigned char type;		// TypeEvenement
+  unsigned char contenu;	// TypeContenant concerné
+  char num;			// Numéro du composant ou du produit
+  char op;			// Opération effectuée ou attendue
+  short pos;			// Position logique sur l'anneau
+  short etat;			// État du produit après l'événement
+  int acteur;			// Id du robot, ACTEUR_SERVEUR ou ACTEUR_ANNEAU
+  int id;			// Numéro de série du composant ou du produit
+} Evenement;
+
+/**
+ * Structure EnteteJournal: en-tête de chaque fichier de journal
+ */
+typedef struct {
+  char magique[4];
+  int acteur;
+  pid_t pid;
+  int nbCases;	// Nombre de cases de l'anneau enregistré
+} EnteteJournal;
+
+Sortie __sortie;	// Mode de sortie du processus
+
+/**
+ * Extrait les options --quiet et --log=<text|binary|trace> de la ligne de commande
+ * et retourne le nombre d'arguments restants
+ */
+int lire_options_sortie(int argc, char **argv);
+
+/**
+ * Ouvre le journal du processus et démarre l'écrivain (modes SORTIE_BINAIRE et SORTIE_TRACE)
+ */
+void journal_ouvrir(int acteur);
+
+/**
+ * Enregistre un événement sans bloquer: l'événement est perdu si le tampon est plein
+ */
+void journal(TypeEvenement type, TypeContenant contenu, char num, char op, int pos, int etat, int id);
+
+/**
+ * Encadre le traitement d'une rotation (mode SORTIE_TRACE uniquement)
+ */
+void journal_debut();
+void journal_fin();
+
+/**
+ * Vide le tampon, arrête l'écrivain et ferme le journal
+ */
+void journal_fermer();
+
+#endif
@@ -0,0 +1,375 @@
+#include "lecteur.h"
+
+/**
+ * Global vars: définis dans le fichier lecteur.h
+ * @var EvenementLu *evenements		Événements de tous les journaux
+ * @var int nbEvenements		Nombre d'événements chargés
+ * @var Case *vue			Anneau reconstitué (positions logiques)
+ * @var int nbCases			Nombre de cases, lu dans l'en-tête des journaux
+ */
+
+int main(int argc, char *argv[]) {
+  bool anneau = false;
+  bool trace = false;
+  int i;
+  
+  if (argc < 2) {
+    __raise(-1, "Usage: %s [--anneau | --trace] <journal-pid.bin ...>", argv[0]);
+  }
+  
+  //
+  // Chargement de tous les journaux
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--anneau") == 0) {
+      anneau = true;
+    } else if (strcmp(argv[i], "--trace") == 0) {
+      trace = true;
+    } else {
+      charger(argv[i]);
+    }
+  }
+  
+  qsort(evenements, nbEvenements, sizeof(EvenementLu), comparer);
+  
+  if (trace) {
+    exporter_trace();
+    free(evenements);
+    return 0;
+  }
+  
+  //
+  // Liste des événements ou reconstitution de l'anneau rotation par rotation
+  vue = malloc(nbCases * sizeof(Case));
+  
+  for (i = 0; i < nbCases; i++) {
+    vue[i].num  = i;
+    vue[i].type = VIDE;
+  }
+  
+  for (i = 0; i < nbEvenements; i++) {
+    if (!anneau) {
+      afficher(&evenements[i], evenements[0].ev.date);
+      continue;
+    }
+    
+    rejouer(&evenements[i].ev);
+    
+    if (i + 1 == nbEvenements || evenements[i + 1].ev.generation != evenements[i].ev.generation) {
+      info_anneau(evenements[i].ev.generation);
+    }
+  }
+  
+  free(vue);
+  free(evenements);
+  return 0;
+}
+
+/**
+ * Charge les événements d'un fichier de journal
+ */
+void charger(char *fichier) {
+  EnteteJournal entete;
+  Evenement ev;
+  FILE *f;
+  
+  if ((f = fopen(fichier, "rb")) == NULL) {
+    __raise(-2, "Impossible d'ouvrir le journal %s", fichier);
+  }
+  
+  if (fread(&entete, sizeof(EnteteJournal), 1, f) != 1 || memcmp(entete.magique, JOURNAL_MAGIQUE, 4) != 0) {
+    __raise(-3, "%s n'est pas un journal d'anneau", fichier);
+  }
+  
+  if (nbCases != 0 && entete.nbCases != nbCases) {
+    __raise(-3, "%s: anneau de %d cases, %d attendues", fichier, entete.nbCases, nbCases);
+  }
+  nbCases = entete.nbCases;
+  
+  while (fread(&ev, sizeof(Evenement), 1, f) == 1) {
+    if (nbEvenements % 4096 == 0) {
+      evenements = realloc(evenements, (nbEvenements + 4096) * sizeof(EvenementLu));
+    }
+    evenements[nbEvenements].ev  = ev;
+    evenements[nbEvenements].pid = entete.pid;
+    nbEvenements++;
+  }
+  
+  fclose(f);
+}
+
+/**
+ * Ordre de rejeu: par rotation, la rotation elle-même en premier, puis par date
+ */
+int comparer(const void *a, const void *b) {
+  const Evenement *x = &((const EvenementLu *) a)->ev;
+  const Evenement *y = &((const EvenementLu *) b)->ev;
+  
+  if (x->generation != y->generation) {
+    return x->generation < y->generation ? -1 : 1;
+  }
+  if ((x->type == EV_ROTATION) != (y->type == EV_ROTATION)) {
+    return x->type == EV_ROTATION ? -1 : 1;
+  }
+  if (x->date != y->date) {
+    return x->date < y->date ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * Nom de l'acteur d'un événement
+ */
+char* desc_acteur(Evenement *ev) {
+  static char str[16];
+  
+  if (ev->acteur == ACTEUR_ANNEAU) {
+    return "anneau";
+  }
+  if (ev->acteur == ACTEUR_SERVEUR) {
+    return "serveur";
+  }
+  sprintf(str, "R%d", ev->acteur);
+  return str;
+}
+
+/**
+ * Affiche un événement sur une ligne
+ */
+void afficher(EvenementLu *e, unsigned long long origine) {
+  Evenement *ev = &e->ev;
+  
+  printf("%12.6f  %6u  %-8s %6d  ", (ev->date - origine) / 1e9, ev->generation, desc_acteur(ev), (int) e->pid);
+  
+  switch (ev->type) {
+    case EV_ROTATION:
+      printf("rotation, tête en %d\n", ev->pos);
+      break;
+      
+    case EV_PRISE:
+      if (ev->contenu == COMPOSANT) {
+	printf("prend C%d en %d\n", ev->num, ev->pos);
+      } else {
+	printf("prend P%d attente Op%d en %d\n", ev->num, ev->op, ev->pos);
+      }
+      break;
+      
+    case EV_POSE:
+      if (ev->contenu == COMPOSANT) {
+	printf("pose C%d en %d\n", ev->num, ev->pos);
+      } else if (ev->etat == -1) {
+	printf("pose P%d terminé en %d\n", ev->num, ev->pos);
+      } else {
+	printf("pose P%d attente Op%d en %d\n", ev->num, ev->op, ev->pos);
+      }
+      break;
+      
+    case EV_OPERATION:
+      printf("opération %d sur P%d%s\n", ev->op, ev->num, ev->etat == -1 ? " => terminé" : "");
+      break;
+      
+    case EV_EXPEDITION:
+      printf("stock de P%d terminé\n", ev->num);
+      break;
+      
+    case EV_INJECTION:
+      printf("distribution de C%d\n", ev->num);
+      break;
+      
+    case EV_ASSEMBLAGE:
+      printf("P%d initialisé\n", ev->num);
+      break;
+      
+    case EV_DEBUT:
+      printf("début de traitement\n");
+      break;
+      
+    case EV_FIN:
+      printf("fin de traitement\n");
+      break;
+      
+    default:
+      printf("événement inconnu %d\n", ev->type);
+  }
+}
+
+/**
+ * Applique un événement à l'anneau reconstitué
+ */
+void rejouer(Evenement *ev) {
+  static Case c;
+  static int i;
+  
+  switch (ev->type) {
+    case EV_ROTATION:
+      // Le contenu de la position i+1 passe en position i
+      c = vue[0];
+      for (i = 0; i < nbCases - 1; i++) {
+	vue[i] = vue[i + 1];
+      }
+      vue[nbCases - 1] = c;
+      break;
+      
+    case EV_PRISE:
+    case EV_EXPEDITION:
+      vue[ev->pos].type = VIDE;
+      break;
+      
+    case EV_INJECTION:
+    case EV_POSE:
+      vue[ev->pos].type = ev->contenu;
+      if (ev->contenu == COMPOSANT) {
+	vue[ev->pos].c.num = ev->num;
+      } else {
+	// Seule l'opération attendue est connue: elle est placée en tête de la gamme
+	vue[ev->pos].p.num = ev->num;
+	vue[ev->pos].p.etat = ev->etat == -1 ? -1 : 0;
+	vue[ev->pos].p.ops[0] = ev->op;
+      }
+      break;
+  }
+}
+
+/**
+ * Affiche l'anneau reconstitué comme l'anneau le fait en mode texte
+ */
+void info_anneau(unsigned int generation) {
+  static int i;
+  
+  printf("\tRotation %5u: \n", generation);
+  
+  for (i = 0; i < nbCases; i++) {
+    printf ("\t\tPosition %2d: Case[%2d] : %s\n", i, vue[i].num, desc_case(&vue[i]));
+  }
+}
+
+/**
+ * Exporte les événements au format Chrome Trace Event (JSON, lisible par Perfetto)
+ *   - une piste par acteur: anneau (rotations), serveur et chaque robot (opérations)
+ *   - un flux par numéro de série: de l'injection du composant à l'expédition du produit
+ * Les traitements (EV_DEBUT/EV_FIN) ne sont présents qu'avec --log=trace
+ */
+void exporter_trace() {
+  static char nom[64];
+  Evenement *ev;
+  unsigned long long origine;
+  unsigned int *pose;	// Génération de la dernière mise sur l'anneau, par numéro de série
+  int *premier, *dernier;	// Premier et dernier événement de chaque flux
+  bool acteurs[256] = {false};
+  int i, maxId = 0, tid;
+  double ts;
+  
+  if (nbEvenements == 0) {
+    printf("{\"traceEvents\":[]}\n");
+    return;
+  }
+  origine = evenements[0].ev.date;
+  
+  for (i = 0; i < nbEvenements; i++) {
+    if (evenements[i].ev.id > maxId) {
+      maxId = evenements[i].ev.id;
+    }
+  }
+  pose    = calloc(maxId + 1, sizeof(unsigned int));
+  premier = malloc((maxId + 1) * sizeof(int));
+  dernier = malloc((maxId + 1) * sizeof(int));
+  
+  for (i = 0; i <= maxId; i++) {
+    premier[i] = dernier[i] = -1;
+  }
+  for (i = 0; i < nbEvenements; i++) {
+    ev = &evenements[i].ev;
+    if (ev->id > 0) {
+      if (premier[ev->id] == -1) {
+	premier[ev->id] = i;
+      }
+      dernier[ev->id] = i;
+    }
+  }
+  
+  printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ligne\"}}");
+  
+  for (i = 0; i < nbEvenements; i++) {
+    ev  = &evenements[i].ev;
+    ts  = (ev->date - origine) / 1000.0;
+    tid = ev->acteur + 2; // anneau: 1, serveur: 2, robots: id + 2
+    
+    // Nom de la piste de l'acteur
+    if (tid >= 0 && tid < 256 && !acteurs[tid]) {
+      acteurs[tid] = true;
+      printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, desc_acteur(ev));
+      printf(",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", tid, tid);
+    }
+    
+    switch (ev->type) {
+      case EV_ROTATION:
+	printf(",\n{\"name\":\"rotation\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"generation\":%u,\"tete\":%d}}", tid, ts, ev->generation, ev->pos);
+	continue;
+	
+      case EV_DEBUT:
+	printf(",\n{\"name\":\"traitement\",\"ph\":\"B\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"generation\":%u}}", tid, ts, ev->generation);
+	continue;
+	
+      case EV_FIN:
+	printf(",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", tid, ts);
+	continue;
+	
+      case EV_INJECTION:
+	sprintf(nom, "injection C%d", ev->num);
+	break;
+	
+      case EV_PRISE:
+	if (ev->contenu == COMPOSANT) {
+	  sprintf(nom, "prise C%d", ev->num);
+	} else {
+	  sprintf(nom, "prise P%d (Op%d)", ev->num, ev->op);
+	}
+	break;
+	
+      case EV_POSE:
+	sprintf(nom, "pose %c%d", ev->contenu == COMPOSANT ? 'C' : 'P', ev->num);
+	break;
+	
+      case EV_ASSEMBLAGE:
+	sprintf(nom, "assemblage P%d", ev->num);
+	break;
+	
+      case EV_OPERATION:
+	sprintf(nom, "Op%d sur P%d", ev->op, ev->num);
+	break;
+	
+      case EV_EXPEDITION:
+	sprintf(nom, "expédition P%d", ev->num);
+	break;
+	
+      default:
+	continue;
+    }
+    
+    // Tranche de l'action: support des flux
+    printf(",\n{\"name\":\"%s\",\"cat\":\"action\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":1,\"args\":{\"serie\":%d,\"position\":%d,\"generation\":%u",
+	   nom, tid, ts, ev->id, ev->pos, ev->generation);
+    
+    // Attente sur l'anneau depuis la dernière mise en circulation
+    if ((ev->type == EV_PRISE || ev->type == EV_EXPEDITION) && ev->id > 0 && pose[ev->id] != 0) {
+      printf(",\"attente\":%u,\"tours\":%u", ev->generation - pose[ev->id], (ev->generation - pose[ev->id]) / nbCases);
+    }
+    if ((ev->type == EV_INJECTION || ev->type == EV_POSE) && ev->id > 0) {
+      pose[ev->id] = ev->generation;
+    }
+    printf("}}");
+    
+    // Flux du numéro de série
+    if (ev->id > 0 && premier[ev->id] != dernier[ev->id]) {
+      printf(",\n{\"name\":\"serie %d\",\"cat\":\"flux\",\"ph\":\"%s\",\"id\":%d,\"pid\":1,\"tid\":%d,\"ts\":%.3f%s}",
+	     ev->id, premier[ev->id] == i ? "s" : (dernier[ev->id] == i ? "f" : "t"), ev->id, tid, ts,
+	     premier[ev->id] == i ? "" : ",\"bp\":\"e\"");
+    }
+  }
+  
+  printf("\n]}\n");
+  
+  free(pose);
+  free(premier);
+  free(dernier);
+}
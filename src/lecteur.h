@@ -0,0 +1,55 @@
+/*--------------------------------------*/
+/* Lecteur des journaux binaires        */
+/*--------------------------------------*/
+
+#include "common.c"
+#include "journal.c"
+
+/**
+ * Structure EvenementLu: événement et fichier d'origine
+ */
+typedef struct {
+  Evenement ev;
+  pid_t pid;
+} EvenementLu;
+
+EvenementLu *evenements; // Événements de tous les journaux
+int nbEvenements;
+
+Case *vue;   // Anneau reconstitué (positions logiques)
+int nbCases; // Nombre de cases, lu dans l'en-tête des journaux
+
+/**
+ * Charge les événements d'un fichier de journal
+ */
+void charger(char *fichier);
+
+/**
+ * Ordre de rejeu: par rotation, la rotation elle-même en premier, puis par date
+ */
+int comparer(const void *a, const void *b);
+
+/**
+ * Nom de l'acteur d'un événement
+ */
+char* desc_acteur(Evenement *ev);
+
+/**
+ * Affiche un événement sur une ligne
+ */
+void afficher(EvenementLu *e, unsigned long long origine);
+
+/**
+ * Applique un événement à l'anneau reconstitué
+ */
+void rejouer(Evenement *ev);
+
+/**
+ * Affiche l'anneau reconstitué comme l'anneau le fait en mode texte
+ */
+void info_anneau(unsigned int generation);
+
+/**
+ * Exporte les événements au format Chrome Trace Event (JSON, lisible par Perfetto)
+ */
+void exporter_trace();
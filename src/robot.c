@@ -10,20 +10,32 @@
 
 int main(int argc, char *argv[]) {
   
-  if (argc != 6) {
-    __raise(-1, "Usage: %s <projet, id, ops, chaîne de produits, chaîne de produits en mode dégradés>", argv[0]);
+  argc = lire_options_sortie(argc, argv);
+  argc = lire_option_entier(argc, argv, "--anneau=", &numero);
+  
+  if (argc != 6 || numero < 0 || numero >= NB_ANNEAUX_MAX) {
+    __raise(-1, "Usage: %s <projet, id, ops, chaîne de produits, chaîne de produits en mode dégradés> [--anneau=0..%d] [--quiet | --log=binary | --log=trace]", argv[0], NB_ANNEAUX_MAX - 1);
   }
   
   //
   // Initialisation
   init(argv);
+  journal_ouvrir(poste.bot.id);
+  
+  //
+  // Signaux bloqués: SIGINT, SIGTERM et SIGUSR2 sont traités par la boucle principale
+  sigemptyset(&signaux);
+  sigaddset(&signaux, SIGINT);
+  sigaddset(&signaux, SIGTERM);
+  sigaddset(&signaux, SIGUSR2);
+  sigprocmask(SIG_BLOCK, &signaux, NULL);
   
   //
   // Attente de connexion du coordinateur
-  while (__anneau->connexion[ANNEAU_POS_SERV_OUT] == 0) {
+  while (__connexions[ANNEAU_POS_SERV_OUT] == 0) {
     usleep(1000);
   }
-  pid_coord = __anneau->connexion[ANNEAU_POS_SERV_OUT];
+  pid_coord = __connexions[ANNEAU_POS_SERV_OUT];
   
   //
   // Démarrage du dispositif de communication avec le serveur
@@ -35,22 +47,26 @@ int main(int argc, char *argv[]) {
   connect_to_coord(argv[1]);
 
   //
-  // Chargement des signaux SIGUSR1, SIGUSR2 et SIGINT
-  signal(SIGINT, callback_sigint);
-  signal(SIGUSR1, callback_sigusr1_anneau_tourne);
-  signal(SIGUSR2, callback_sigusr2_mode);
+  // Début du travail: boucle d'événements (rotations notifiées et signaux)
+  Abonne *abonne = &(__abonnes[poste.bot.idx]);
+  unsigned int g;
   
-  //
-  // Début du travail
-  sigset_t mask;
+  // Une rotation notifiée avant l'entrée dans la boucle est traitée tout de suite
+  tick.derniere = abonne->acquitte;
+  tick.notifications = abonne->notifications;
+  allocations_verrouiller();
   
-  sigfillset(&mask);
-  sigdelset(&mask, SIGINT);
-  sigdelset(&mask, SIGUSR1);
-  sigdelset(&mask, SIGUSR2);
-  
-  while (1) {    
-    sigsuspend(&mask);
+  while (1) {
+    g = anneau_attendre_rotation(&abonne->reveil, tick.derniere, DELAI_SIGNAUX_MS);
+    
+    traiter_signaux();
+    suivre_abonnement(abonne);
+    
+    if (g != tick.derniere) {
+      cadencement_enregistrer(&tick, g, abonne->notifications);
+      traiter_rotation();
+      anneau_acquitter(&abonne->acquitte, g);
+    }
   }
   
   return 0;
@@ -60,76 +76,74 @@ int main(int argc, char *argv[]) {
 * Initialisation principale
 */
 void init(char **argv) {
-  void *anneau_addr;
   pid_t pid = getpid();
-  int i;
-  
-  produits = init_produits();
   
   printf("== Initialisation du robot R%s (%d)...\n", argv[2], (int) pid);
   
-  bot.id   = atoi(argv[2]);
-  bot.pid  = getpid();
-  bot.mode = NORMAL;
-  bot.pos  = -1;
-  
-  sprintf(bot.ops, "%s", argv[3]);
-  sprintf(bot.prods, "%s", argv[4]);
-  sprintf(bot.prodsDegrades, "%s", argv[5]);
-  
-  for (i = 0; i < NB_PROD; i++) {
-    bot.stockComposants[i] = 0;
-    bot.stockProduits[i] = 0;
-  }
-  
   //
-  // Mémoire partagée
+  // Mémoire partagée et sémaphore de l'anneau rejoint: les recettes sont nécessaires au poste
   printf("==== Initialisation de la mémoire partagée\n");
+  anneau_attacher(argv[1], numero);
   
-  if ((__shmid = shmget(ftok(argv[1], ANNEAU_SHM_KEY), ANNEAU_SHM_SIZE, 0666)) == -1) {
-    __raise(-3, "======== ERROR: Impossible de se connecter à la mémoire partagé. Rassurez-vous que l'anneau est en cours de fonctionnement");
-  }
-  // Attachement à une adresse choisie par le système
-  if ((anneau_addr = shmat(__shmid, NULL, 0)) == (void *) -1) {
-    __raise(-4, "======== ERROR: Attachement impossible");
+  poste_init(&poste, atoi(argv[2]), argv[3], argv[4], argv[5]);
+  poste.bot.pid = pid;
+  poste.bot.anneau = numero;
+}
+
+/**
+ * Traite les signaux en attente: appelée par la boucle principale
+ */
+void traiter_signaux() {
+  static struct timespec immediat = {0, 0};
+  static int s;
+  
+  while ((s = sigtimedwait(&signaux, NULL, &immediat)) > 0) {
+    switch (s) {
+      case SIGINT:
+      case SIGTERM:
+	callback_sigint(s);
+	break;
+	
+      case SIGUSR2:
+	callback_sigusr2_mode(s);
+	break;
+    }
   }
-  printf("====== Connecté à la mémoire partagée %d\n", __shmid);
-  
-  // Initialisation de l'anneau
-  __anneau = (Anneau *) anneau_addr;
-  
-  //
-  // Création du sémaphore
-  __semaphore = sem_open(SEM_NAME, 0);
 }
 
 /**
  * Fonction de rappel SIGINT
  */
 void callback_sigint(int s) {
+  allocations_deverrouiller();
+  
   printf("\n==== Réception du signal SIGINT");
   printf("\n====== Interuption du processus en cours...\n");
   
-  // Envoie d'un signal au coordinateur
-  if (pid_coord != 0) {
-    QueryConnexion query;
+  // Envoie d'un signal au coordinateur, si la boîte est toujours la nôtre
+  if (boite != -1 && __boites[boite].pid == poste.bot.pid) {
+    RequeteControle query;
     
-    query.type  = pid_coord;
-    query.query = COORD_MSG_GOODBYE;
-    query.bot   = bot;
+    query.type  = COORD_MSG_GOODBYE;
+    query.boite = boite;
+    query.bot   = poste.bot;
     
-    msgsnd(msgid, &query, sizeof(QueryConnexion) - sizeof(long), 0);
+    controle_envoyer(&query);
+    controle_fermer_boite(boite);
   }
   
-  // Déconnexion de l'anneau
-  if (bot.pos != -1) {
-    __anneau->connexion[bot.pos] = 0;
+  // Déconnexion de l'anneau, à la position où le coordinateur a placé le robot
+  if (poste.bot.idx >= 0 && poste.bot.idx < __anneau->nbRobots) {
+    sem_wait(__semaphore);
+    poste.bot.pos = __abonnes[poste.bot.idx].pos;
+    if (poste.bot.pos >= 0) {
+      __connexions[poste.bot.pos] = 0;
+    }
+    __abonnes[poste.bot.idx].pid = 0;
+    sem_post(__semaphore);
     printf("\n====== Déconnecté de l'anneau\n");
   }
   
-  // Suppression IPCs
-  msgctl(__shmid, IPC_RMID, NULL);
-  
   // Fermeture du sémaphore
   int sem_val;
   if (sem_getvalue(__semaphore, &sem_val) == 0) {
@@ -139,13 +153,11 @@ void callback_sigint(int s) {
   }
   sem_close(__semaphore);
   
-  // Libération de l'anneau
-  free(produits);
+  // Détachement de l'anneau (recettes comprises)
+  shmdt(__anneau);
+  
+  journal_fermer();
   
-  // Interuption du thread
-  if (pthread_cancel(thread_id) != 0) {
-    printf("\n====== Échec d'interruption du thread\n");
-  }
   
   __end_process();
   exit(0);
@@ -154,327 +166,229 @@ void callback_sigint(int s) {
 /**
  * Connexion au coordinateur
  *   Opérations:
- * 	0: Connexion à la file de message ouverte par le coordinateur
+ * 	0: Prise d'une boîte de réponse dans le segment partagé
  * 	1: Connexion au coordinateur
  * 	2: Réception de l'indice de positionnement sur l'anneau
  */
 void connect_to_coord(char *project) {
-  QueryPing q;
-  QueryPingResponse r;
-  int query_size = sizeof(QueryPing) - sizeof(long);
-  int query_response_size = sizeof(QueryPingResponse) - sizeof(long);
+  RequeteControle query;
+  ReponseControle response;
   
   //
-  // File de message: Bus de communication entre le coordinateur et les robots
-  if ((msgid = msgget(ftok(project, ANNEAU_SHM_KEY * pid_coord), 0666)) == -1) {
-    __raise(1, "======== ERROR: Impossible de créer la file de message !");
+  // Boîte de réponse: canal de contrôle entre le coordinateur et les robots
+  if ((boite = controle_ouvrir_boite(poste.bot.pid)) == -1) {
+    __raise(2, "======== ERROR: Aucune boîte de réponse libre sur l'anneau");
   }
-  printf("====== Connecté au buss coord %d\n", msgid);
+  printf("====== Boîte de réponse %d du canal de contrôle\n", boite);
   
   //
   // Connexion au coordinateur
-  QueryConnexion query;
-  QueryConnexionResponse response;
-  int query_connexion_size = sizeof(QueryConnexion) - sizeof(long);
-  int query_connexion_response_size = sizeof(QueryConnexionResponse) - sizeof(long);
+  query.type  = COORD_MSG_HELLO;
+  query.boite = boite;
+  query.bot   = poste.bot;
   
-  query.type  = pid_coord;
-  query.query = COORD_MSG_HELLO;
-  query.bot   = bot;
+  controle_envoyer(&query);
   
-  msgsnd(msgid, &query, query_connexion_size, 0);
-  msgrcv(msgid, &response, query_connexion_response_size, (int) bot.pid, 0);
+  while (!controle_attendre_reponse(boite, &response, DELAI_SIGNAUX_MS)) {
+    if (kill(pid_coord, 0) == -1 && errno == ESRCH) {
+      __raise(1, "======== ERROR: Le coordinateur ne répond plus");
+    }
+  }
   
-  bot.pos = response.pos;
+  poste.bot.pos = response.pos;
+  poste.bot.idx = response.idx;
+  
+  if (poste.bot.idx < 0 || poste.bot.idx >= __anneau->nbRobots) {
+    __raise(2, "======== ERROR: Aucun abonnement libre sur l'anneau");
+  }
   
   //
-  // Connexion à l'anneau
-  __anneau->connexion[bot.pos] = bot.pid;
-  printf("====== Robot %d connecté en %d\n", bot.id, bot.pos);
+  // Connexion à l'anneau: faite par le coordinateur, qui peut ensuite replacer le robot
+  printf("====== Robot %d connecté en %d\n", poste.bot.id, poste.bot.pos);
 }
 
 /**
  * Fonction de rappel SIGUSR2: Permet de basculer au mode dégradé/normal
  */
 void callback_sigusr2_mode (int s) {
-  bot.mode = bot.mode == NORMAL ? DEGRADE : NORMAL;
+  sem_wait(__semaphore);
+  
+  poste.bot.mode = poste.bot.mode == NORMAL ? DEGRADE : NORMAL;
+  __abonnes[poste.bot.idx].mode = poste.bot.mode;
+  publier_interet();
+  
+  sem_post(__semaphore);
+  
   info();
   return;
 }
 
 /**
- * Définit si le caractère val existe dans la chaîne array
+ * Battement de cœur et consignes du serveur lues dans l'abonnement, à chaque tour de
+ * la boucle principale: rôle et mode imposés, abonnement repris (robot déclaré disparu)
  */
-static bool has(char *array, char val) {
-  static int i;
-  
-  for (i = 0; array[i]; i++) {
-    if (array[i] == val) {
-      return true;
-    }
+void suivre_abonnement(Abonne *abonne) {
+  __atomic_add_fetch(&abonne->battement, 1, __ATOMIC_RELAXED);
+  
+  if (__atomic_load_n(&abonne->pid, __ATOMIC_ACQUIRE) != poste.bot.pid) {
+    printf("\n==== Abonnement repris par le coordinateur: robot resté trop longtemps silencieux\n");
+    // Boîte déjà fermée par le coordinateur, peut-être rendue à un autre robot: ni GOODBYE ni fermeture
+    poste.bot.idx = -1;
+    boite = -1;
+    callback_sigint(SIGTERM);
   }
-  return false;
-}
-
-/**
- * c'est pas assez clair le nom de la fonction ? :)
- */
-bool puis_je_prendre_composant() {
-  // Si je peux travailler sur le produit correspondant
-  if (has(bot.mode == NORMAL ? bot.prods : bot.prodsDegrades, (__anneau->cases[bot.pos]).c.num)) {
-    static int i;
-    i = ctoi((__anneau->cases[bot.pos]).c.num) - 1;
-    
-    // Si j'ai de la place pour stocker ce composant
-    if (bot.stockComposants[i] < 3) {
-      // S'il manque n-1 composants pour initaliser le produit
-      if (bot.stockComposants[i] == (produits[i].nbComp - 1)) {
-	// S'il y a de place pour stocker le futur produit
-	if (bot.stockProduits[i] == 0) {
-	  // Alors oui, je peux prendre ce composant
-	  return true;
-	}
-      } else {
-	return true;
-      }
-    }
+  
+  if (poste_consignes_changees(&poste, abonne)) {
+    sem_wait(__semaphore);
+    poste_suivre(&poste, abonne);
+    publier_interet();
+    sem_post(__semaphore);
+  
+    printf("\n==== Rôle imposé par le serveur: opération %d, mode %s%s\n", poste.op, poste.bot.mode == NORMAL ? "normal" : "dégradé",
+	   poste.composantsRefuses ? ", composants regroupés ailleurs" : "");
+    info();
   }
-  return false;
 }
 
 /**
- * c'est pas assez clair le nom de la fonction ? :)
+ * Traitement d'une rotation par le robot.
+ * Exécutée par la boucle principale quand la case devant le robot le concerne
  */
-bool puis_je_prendre_produit() {
-  // Si je fonctionne en mode NORMAL
-  if (bot.mode == NORMAL) {
-    // Si le produit nécessite une opération op (en production)
-    if ((__anneau->cases[bot.pos]).p.etat >= 0) {
-      // Si j'ai de la place pour stocker ce produit
-      if (bot.stockProduits[ctoi((__anneau->cases[bot.pos]).p.num) - 1] == 0) {
-	// Si je peux travailler sur ce produit
-	if (has(bot.prods, (__anneau->cases[bot.pos]).p.num)) {
-	  // Si je peux effectuer l'opération nécessaire (op)
-	  if (bot.ops[0] == (__anneau->cases[bot.pos]).p.ops[(__anneau->cases[bot.pos]).p.etat]) {
-	    // Alors oui, je peux prendre ce produit
-	    return true;
-	  }
-	}
-      }
-    }
-  } else { // Mode Dégradé
-    // Si le produit nécessite une opération op (en production)
-    if ((__anneau->cases[bot.pos]).p.etat >= 0) {
-      // Si j'ai de la place pour stocker ce produit
-      if (bot.stockProduits[ctoi((__anneau->cases[bot.pos]).p.num) - 1] == 0) {
-	// Si je peux travailler sur ce produit
-	if (has(bot.prodsDegrades, (__anneau->cases[bot.pos]).p.num)) {
-	  // Si je peux effectuer l'opération nécessaire (op)
-	  if (has(bot.ops, (__anneau->cases[bot.pos]).p.ops[(__anneau->cases[bot.pos]).p.etat])) {
-	    // Alors oui, je peux prendre ce produit
-	    return true;
-	  }
-	}
-      }
-    }
+void traiter_rotation() {
+  static Action a;
+  static MetriquesRobot *m;
+  static unsigned long long entree, demande, pris, sortie;
+  
+  entree = horloge();
+  m = &__metriquesRobots[poste.bot.idx];
+  latence_reveil(&m->reveil, tick.derniere, entree);
+  
+  journal_debut();
+  
+  // Position attribuée par le coordinateur, replanifiée à chaque connexion de robot
+  poste.bot.pos = __abonnes[poste.bot.idx].pos;
+  
+  if (__sortie == SORTIE_TEXTE) {
+    sprintf(log_curr_pos, "%s", desc_case(anneau_case(poste.bot.pos)));
   }
-  return false;
-}
-
-/**
- * c'est pas assez clair le nom de la fonction ? :)
- */
-Composant prendre_composant() {
-  static Composant c;
   
-  c = (__anneau->cases[bot.pos]).c;
+  demande = horloge();
+  sem_wait(__semaphore);
+  pris = horloge();
+  
+  a = poste_traiter(&poste);
+  publier_interet();
+  
+  sem_post(__semaphore);
+  sortie = horloge();
+  journal_fin();
   
-  (__anneau->cases[bot.pos]).type = VIDE;
-  (__anneau->cases[bot.pos]).c.num = 0;
+  latence_fin(&m->manquees, tick.derniere, sortie);
+  latence_ajouter(&m->attente, pris - demande);
+  latence_ajouter(&m->traitement, sortie - entree);
   
-  return c;
+  if (__sortie == SORTIE_TEXTE) {
+    decrire_action(&a);
+    info();
+  }
 }
 
 /**
- * c'est pas assez clair le nom de la fonction ? :)
+ * Publie dans l'anneau les contenus de case sur lesquels le robot peut agir,
+ * et son stock local: le coordinateur le reprend si le robot disparaît
  */
-Produit prendre_produit() {
-  static Produit p;
-  
-  p = (__anneau->cases[bot.pos]).p;
-  
-  (__anneau->cases[bot.pos]).type = VIDE;
-  (__anneau->cases[bot.pos]).p.num = 0;
-  
-  return p;
+void publier_interet() {
+  poste_publier(&poste, &__abonnes[poste.bot.idx]);
 }
 
-void callback_sigusr1_anneau_tourne(int s) {
-  static Composant c;
-  static Produit p;  
-  static int i;
-  static int j = 0;
-  
-  sprintf(log_curr_pos, "%s", desc_case(&(__anneau->cases[bot.pos])));
-  
-  sem_wait(__semaphore);
-  
-  switch ((__anneau->cases[bot.pos]).type) {
-    case COMPOSANT:
-      sprintf(log_out, " ");
+/**
+ * Rédige les messages du tableau de bord à partir de l'action effectuée
+ */
+void decrire_action(Action *a) {
+  switch (a->type) {
+    case ACTION_AUCUNE:
+      sprintf(log_in, " ");
+      sprintf(log, " ");
+      break;
       
-      if (puis_je_prendre_composant()) {
-	c = prendre_composant();
-	
-	sprintf(log_in, "%s", desc_composant(&c));
-	
-	i = ctoi(c.num) - 1;
-	p = produits[i];
-	
-	bot.stockComposants[i]++;
-	
-	if (bot.stockComposants[i] == p.nbComp) {
-	  // Nombre de composants nécessaires atteint
-	  bot.stockComposants[i] = 0;
-	  
-	  // Si je peux réaliser la première opération sur le produit
-	  if (has(bot.ops, p.ops[p.etat])) {
-	    // J'effectue l'opération
-	    sprintf(log, "    opération %c sur P%c", p.ops[p.etat], p.num);
-	    p.etat++; // Prochaine étape
-	  } else {
-	    sprintf(log, "       P%c initialisé", p.num);
-	  }
-	  
-	  bot.stockProduits[i]++;
-	  
-	  info();
-	  
-	  produitsStock[i] = p;
-	} else {
-	  sprintf(log, " ");
-	  info();
-	}
-      } else {
-	sprintf(log_in, " ");
-	sprintf(log, " ");
-	info();
-      }
+    case ACTION_PRISE_COMPOSANT:
+      sprintf(log_in, "%s", desc_composant(&a->c));
+      sprintf(log, " ");
       break;
       
-    case PRODUIT:
-      p = (__anneau->cases[bot.pos]).p;
+    case ACTION_INITIALISATION:
+      sprintf(log_in, "%s", desc_composant(&a->c));
+      sprintf(log, "       P%d initialisé", a->p.num);
+      break;
       
-      if (puis_je_prendre_produit()) {
-	// Je peux réaliser l'opération p.ops[p.etat] nécessaire
-	
-	p = prendre_produit(); // Je prends le produit
-	
-	sprintf(log_in, "%s", log_curr_pos);
-	
-	// J'effectue l'opération
-	p.etat++; // Prochaine opération
-	
-	if (p.etat == strlen(p.ops)) {
-	  sprintf(log, "opération %c sur P%c => P%c terminé", p.ops[p.etat], p.num, p.num);
-	  
-	  p.etat = -1; // Produit terminée
-	} else {
-	  sprintf(log, "    opération %c sur P%c [%d]", p.ops[p.etat], p.num, p.etat);
-	}
-	
-	info();
-	
-	i = ctoi(p.num) - 1;
-	
-	produitsStock[i] = p;
-	bot.stockProduits[i]++;	
-      } else {
-	sprintf(log_in, " ");
-	info();
-      }
+    case ACTION_ASSEMBLAGE:
+      sprintf(log_in, "%s", desc_composant(&a->c));
+      sprintf(log, "    opération %d sur P%d", a->op, a->p.num);
       break;
       
-    case VIDE:
-      if (nb_cases_vides() == ANNEAU_NUM_CASES) {
-	for (i = 0; i < NB_PROD; i++) {
-	  if ((bot.stockComposants[i] == 1 && produits[i].nbComp > 1) || (bot.stockComposants[i] == 2 && produits[i].nbComp == 3)) {
-	    // Je remets le composant i sur l'anneau
-	    (__anneau->cases[bot.pos]).c.num = itoc(i + 1);
-	    (__anneau->cases[bot.pos]).type = COMPOSANT;
-	    bot.stockComposants[i]--;
-	    
-	    sprintf(log, " pose le C%d sur l'anneau", i+1);
-	    break;
-	  }
-	}
-      }
+    case ACTION_OPERATION:
+      sprintf(log_in, "%s", desc_produit(&a->pris));
       
-      if ((__anneau->cases[bot.pos]).type == VIDE) {
-	while (j < NB_PROD) {
-	  if (bot.stockProduits[j] == 1) {
-	    // je pose le produit j sur la case
-	    p = produitsStock[j];
-	    
-	    sprintf(log, "  pose P%c sur la case %d", p.num, (__anneau->cases[bot.pos]).num);
-	    
-	    (__anneau->cases[bot.pos]).p = p;
-	    (__anneau->cases[bot.pos]).type = PRODUIT;
-	    
-	    bot.stockProduits[j] = 0;
-	    
-	    sprintf(log_in, " ");
-	    sprintf(log_out, "%s", desc_produit(&p));
-	    
-	    j++;
-	    break;
-	  }
-	  j++;
-	}
-	
-	if (j >= NB_PROD) {
-	  j = 0;
-	}
+      if (a->p.etat == -1) {
+	sprintf(log, "opération %d sur P%d => P%d terminé", a->op, a->p.num, a->p.num);
+      } else {
+	sprintf(log, "    opération %d sur P%d [%d]", a->op, a->p.num, a->p.etat);
       }
+      break;
+      
+    case ACTION_POSE_COMPOSANT:
+      sprintf(log, " pose le %s sur l'anneau", desc_composant(&a->c));
+      break;
       
-      info();
+    case ACTION_POSE_PRODUIT:
+      sprintf(log, "  pose P%d sur la case %d", a->p.num, anneau_case(poste.bot.pos)->num);
+      sprintf(log_in, " ");
+      sprintf(log_out, "%s", desc_produit(&a->p));
       break;
   }
-  
-  sem_post(__semaphore);
-  
-  return;
 }
 
 /**
  * Affichage des informations du serveur
  */
 void info() {
-  static char prods[NB_PROD];
+  static int i;
   
-  strncpy(prods, bot.prods, NB_PROD);
+  if (__sortie != SORTIE_TEXTE) {
+    return;
+  }
   
   printf("⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯\n");
-  printf("        Robot : %d\n", bot.id);
-  printf("          PID : %d\n", (int) bot.pid);
-  printf("         Mode : %s\n", (bot.mode == NORMAL ? "NORMAL " : "DÉGRADÉ"));
-  printf("   Opérations : N[%c] D[%s]\n", bot.ops[0], bot.ops);
-  printf("     Capacité : N[%s] D[%s]\n", prods, bot.prodsDegrades);
-  printf("     Position : %d\n\n", bot.pos);
+  printf("        Robot : %d\n", poste.bot.id);
+  printf("          PID : %d\n", (int) poste.bot.pid);
+  printf("         Mode : %s\n", (poste.bot.mode == NORMAL ? "NORMAL " : "DÉGRADÉ"));
+  printf("   Opérations : N[%d] D[%s]\n", poste.op, desc_liste(poste.bot.ops));
+  printf("     Capacité : N[%s] D[%s]\n", desc_liste(poste.bot.prods), desc_liste(poste.bot.prodsDegrades));
+  printf("     Position : %d (anneau %d)\n\n", poste.bot.pos, poste.bot.anneau);
   
   printf("⎬⎯⎯⎯⎯⎯⎯⎯⎯[état in/out]⎯⎯⎯⎯⎯⎯⎯⎯⎨\n");
-  printf("       POS %2d : %s\n", bot.pos, log_curr_pos);
+  printf("       POS %2d : %s\n", poste.bot.pos, log_curr_pos);
   printf("           IN : %s\n", log_in);
   printf("          OUT : %s\n\n", log_out);
   
   printf("⎬⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯[stock]⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎨\n\n");
-  printf("                1  2  3  4\n");
-  printf("    Composant : %d  %d  %d  %d\n", bot.stockComposants[0], bot.stockComposants[1], bot.stockComposants[2], bot.stockComposants[3]);
-  printf("      Produit : %d  %d  %d  %d\n", bot.stockProduits[0], bot.stockProduits[1], bot.stockProduits[2], bot.stockProduits[3]);
-  printf("\n");
+  printf("              ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("%2d ", i + 1);
+  }
+  printf("\n    Composant : ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("%2d ", poste.bot.stockComposants[i]);
+  }
+  printf("\n      Produit : ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("%2d ", poste.bot.stockProduits[i]);
+  }
+  printf("\n\n");
   
   printf("⎬⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯[usine]⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎨\n");
-  printf("  %s\n\n\n", log);
+  printf("  %s\n\n", log);
+  printf("  Rotations : %lu traitées, %lu manquées, retard %u (max %u)\n\n\n", tick.traites, tick.manques, tick.retard, tick.retardMax);
   
   fflush(stdout);
   
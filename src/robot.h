@@ -3,6 +3,8 @@
 /*-----------------*/
 
 #include "common.c"
+#include "journal.c"
+#include "atelier.c"
 
 /**
  * Global vars: définis dans le fichier common.h
@@ -12,17 +14,17 @@
  * @var sem_t *__semaphore	Sémaphore de synchronisation de l'anneau
  */
 
-Robot bot; // Représente le processus robot
+Poste poste; // Représente le processus robot et son stock
 
-pthread_t thread_id;
+int boite = -1; // Boîte de réponse du canal de contrôle
 
-Produit *produits;
-Produit produitsStock[NB_PROD];
-
-int msgid;
+static int numero = 0; // Anneau de la ligne rejoint (--anneau)
 
 pid_t pid_coord; // PID du coordinateur (SERVER)
 
+sigset_t signaux; // Signaux traités par la boucle principale
+Cadencement tick; // Suivi des rotations traitées
+
 /**
  * Vars de log: pour info()
  */
@@ -36,21 +38,27 @@ static char log_out[50];
  */
 void init(char **projet);
 
+/**
+ * Traite les signaux en attente: appelée par la boucle principale
+ */
+void traiter_signaux();
+
 /**
  * Fonction de rappel SIGINT
  */
 void callback_sigint(int s);
 
 /**
- * Fonction de rappel SIGINT
+ * Battement de cœur et consignes du serveur lues dans l'abonnement, à chaque tour de
+ * la boucle principale: rôle et mode imposés, abonnement repris (robot déclaré disparu)
  */
-void callback_sigint (int s);
+void suivre_abonnement(Abonne *abonne);
 
 /**
- * Fonction de rappel SIGUSR1 du robot.
- * Exécutée après que l'anneau ai fait un pas de rotation
+ * Traitement d'une rotation par le robot.
+ * Exécutée par la boucle principale quand la case devant le robot le concerne
  */
-void callback_sigusr1_anneau_tourne(int s);
+void traiter_rotation();
 
 /**
  * Fonction de rappel SIGUSR2: Permet de basculer au mode dégradé/normal
@@ -72,29 +80,15 @@ void callback_sigusr3_ping(int s);
 void connect_to_coord(char *project);
 
 /**
- * Définit si le caractère val existe dans la chaîne array
- */
-static bool has(char *array, char val);
-
-/**
- * c'est pas assez clair le nom de la fonction ? :)
- */
-bool puis_je_prendre_composant();
-
-/**
- * c'est pas assez clair le nom de la fonction ? :)
- */
-bool puis_je_prendre_produit();
-
-/**
- * c'est pas assez clair le nom de la fonction ? :)
+ * Publie dans l'anneau les contenus de case sur lesquels le robot peut agir,
+ * et son stock local: le coordinateur le reprend si le robot disparaît
  */
-Composant prendre_composant();
+void publier_interet();
 
 /**
- * c'est pas assez clair le nom de la fonction ? :)
+ * Rédige les messages du tableau de bord à partir de l'action effectuée
  */
-Produit prendre_produit();
+void decrire_action(Action *a);
 
 /**
  * Affichage d'infos sur le robot
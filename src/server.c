@@ -8,129 +8,279 @@
  * @var sem_t *__semaphore		Sémaphore de synchronisation de l'anneau
  *
  * Global vars: définis dans le fichier server.h
- * @var int msgid 			Identifiant de la file de message
- * @var pthread_t thread_id		ID du thread (coordinateur)
- * @var Produit *produits 		Liste de profils des produits
- * @var int produitsPlanifies[NB_PROD]	Nombre de produits à fabriquer
- * @var int produitsFabriques[NB_PROD]	Nombre de produits fabriqués
- * @var int stockComposants[NB_PROD]	Stock de composants = produitsPlanifies * produitsFabriques
+ * @var int nbAnneaux			Anneaux de la ligne servis par le serveur
+ * @var VueAnneau vues[]		Anneaux attachés
+ * @var Station stations[]		Stations de transfert entre les anneaux
+ * @var pthread_t coordinateurs[]	Un coordinateur par anneau
+ * @var pthread_t servants[]		Traitement des rotations des anneaux suivant le premier
+ * @var pthread_mutex_t verrouLigne	Stock et tableaux de bord communs aux anneaux: un thread à la fois
+ * @var int anneau			Anneau servi par le thread
+ * @var Usine usine			Plan de production et stocks
+ * @var PolitiqueInjection *politique	Politique d'injection choisie au lancement
+ * @var Admission admission		Règle d'admission choisie au lancement
+ * @var TypePlacement typePlacement	Placement des robots choisi au lancement
+ * @var TypeRoles typeRoles		Pilotage des rôles des robots choisi au lancement
+ * @var Battement *surveillances[]	Surveillance des robots de chaque anneau, par abonnement
+ * @var Battement *battements		Celle de l'anneau du coordinateur
+ * @var sigset_t signaux		Signaux traités par la boucle principale
+ * @var Cadencement tick		Suivi des rotations traitées de l'anneau servi
+ * @var struct timespec debutProduction	Date de la première injection
+ * @var struct timespec finProduction	Date de la dernière expédition
+ * @var unsigned int rotationDebut	Génération de la première injection
+ * @var unsigned int rotationFin	Génération de la dernière expédition
+ * @var bool planTermine		Tous les produits planifiés ont été expédiés
  */
 
 int main(int argc, char *argv[]) {
+  char *injection = "tourniquet";
+  char *regle = "seuil";
+  char *placement = "flux";
+  char *roles = "fixes";
+  
+  argc = lire_options_sortie(argc, argv);
+  argc = lire_option_chaine(argc, argv, "--injection=", &injection);
+  argc = lire_option_chaine(argc, argv, "--admission=", &regle);
+  argc = lire_option_chaine(argc, argv, "--placement=", &placement);
+  argc = lire_option_chaine(argc, argv, "--roles=", &roles);
+  argc = lire_option_entier(argc, argv, "--anneaux=", &nbAnneaux);
+  argc = lire_option_chaine(argc, argv, "--stations=", &texteStations);
+  argc = lire_option_chaine(argc, argv, "--ports=", &textePorts);
+  
+  if (argc != 2 || nbAnneaux < 1 || nbAnneaux > NB_ANNEAUX_MAX) {
+    __raise(-1, "Usage: %s <projet> [--injection=POLITIQUE] [--admission=REGLE[:N]] [--placement=flux|regulier] [--roles=fixes|adaptatifs] [--anneaux=1..%d] [--stations=A:pa-B:pb,...] [--ports=i:N,e:N,...] [--quiet | --log=binary | --log=trace]", argv[0], NB_ANNEAUX_MAX);
+  }
+  
+  if ((politique = politique_injection(injection)) == NULL) {
+    printf("Politiques d'injection:\n");
+    politiques_injection_lister();
+    __raise(-1, "Politique d'injection inconnue: %s", injection);
+  }
+  
+  if (!admission_lire(&admission, regle)) {
+    __raise(-1, "Règle d'admission invalide: %s (seuil, conwip, occupation ou retroaction, suivie de :N)", regle);
+  }
+  
+  if (!placement_lire(&typePlacement, placement)) {
+    __raise(-1, "Placement inconnu: %s (flux ou regulier)", placement);
+  }
   
-  if (argc != 2) {
-    __raise(-1, "Usage: %s <projet>", argv[0]);
+  if (!roles_lire(&typeRoles, roles)) {
+    __raise(-1, "Pilotage des rôles inconnu: %s (fixes ou adaptatifs)", roles);
   }
   
   //
   // Initialisation
   init(argv);
+  journal_ouvrir(ACTEUR_SERVEUR);
   
   //
-  // Démarrage du coordinateur de gestion de connexion des robots
-  pthread_create(&thread_id, 0, callback_thread_coord, (void *) argv[1]);
+  // Signaux bloqués: ils sont traités par la boucle principale (hérité par le coordinateur)
+  sigemptyset(&signaux);
+  sigaddset(&signaux, SIGINT);
+  sigaddset(&signaux, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signaux, NULL);
   
   //
-  // Branchement du serveur aux position ANNEAU_POS_SERV_IN et ANNEAU_POS_SERV_OUT
-  __anneau->connexion[ANNEAU_POS_SERV_IN]  = __pid;
-  __anneau->connexion[ANNEAU_POS_SERV_OUT] = __pid;
-  printf("== Serveur connecté aux canneaux d'entrée %d et de sortie %d de l'anneau\n", ANNEAU_POS_SERV_IN, ANNEAU_POS_SERV_OUT);
+  // Démarrage des coordinateurs de gestion de connexion des robots, un par anneau,
+  // et des threads qui servent les anneaux suivant le premier
+  long k;
+  
+  for (k = 0; k < nbAnneaux; k++) {
+    pthread_create(&coordinateurs[k], 0, callback_thread_coord, (void *) k);
+  }
+  for (k = 1; k < nbAnneaux; k++) {
+    pthread_create(&servants[k], 0, callback_thread_anneau, (void *) k);
+  }
   
   //
-  // Armemant de SIGUSR1: exécutée chaque fois que l'anneau tourne
-  signal(SIGINT, callback_sigint_server);
-  signal(SIGUSR1, callback_sigusr1_anneau_tourne);
+  // Branchement du serveur à ses ports supplémentaires, puis aux positions ANNEAU_POS_SERV_IN
+  // et ANNEAU_POS_SERV_OUT de chaque anneau: les robots attendent la sortie pour se connecter
+  for (k = 0; k < nbAnneaux; k++) {
+    anneau_selectionner(&vues[k]);
+    ports_brancher(&usine.ports, __pid);
+    __connexions[ANNEAU_POS_SERV_IN]  = __pid;
+    __connexions[ANNEAU_POS_SERV_OUT] = __pid;
+    printf("== Serveur connecté aux canneaux d'entrée %d et de sortie %d de l'anneau %ld\n", ANNEAU_POS_SERV_IN, ANNEAU_POS_SERV_OUT, k);
+  }
   
   //
-  // Début du travail
-  sigset_t mask;
+  // Début du travail: boucle d'événements du premier anneau (rotations et signaux)
+  allocations_verrouiller();
+  servir_anneau(0);
   
-  sigfillset(&mask);
-  sigdelset(&mask, SIGINT);
-  sigdelset(&mask, SIGUSR1);
+  return 0;
+}
+
+/**
+ * Exécutée par le thread qui sert l'anneau numero (anneaux suivant le premier)
+ */
+void *callback_thread_anneau(void *numero) {
+  servir_anneau((int) (long) numero);
+  return NULL;
+}
+
+/**
+ * Boucle d'événements du thread qui sert l'anneau k: rotations, et signaux pour le premier
+ * Les anneaux tournent chacun à leur rythme; leurs traitements, qui partagent le stock,
+ * se font à tour de rôle (verrouLigne)
+ */
+void servir_anneau(int k) {
+  unsigned int g;
+  
+  anneau = k;
+  anneau_selectionner(&vues[k]);
+  tick.derniere = tick.notifications = __anneau->generation;
+  
+  // Rotations antérieures à la connexion: rien à traiter, la barrière de l'anneau ne les attend pas
+  anneau_acquitter(&__anneau->acquitteServeur, tick.derniere);
   
   while (1) {
-    sigsuspend(&mask);
+    g = anneau_attendre_rotation(&__anneau->generation, tick.derniere, DELAI_SIGNAUX_MS);
+    
+    if (k == 0) {
+      traiter_signaux();
+    }
+    
+    if (g != tick.derniere) {
+      // Le serveur est notifié de toutes les rotations: la génération fait office de compteur
+      cadencement_enregistrer(&tick, g, g);
+      traiter_rotation();
+      anneau_acquitter(&__anneau->acquitteServeur, g);
+    }
   }
-  
-  return 0;
 }
 /**
  * Initialisation principale
  */
 void init(char **argv) {
-  void *anneau_addr;
+  int nbCases[NB_ANNEAUX_MAX];
+  int k, casesMin;
   
   __pid = getpid();
-  produits = init_produits();
-  
-  int i;
-  for (i = 0; i < NB_PROD; i++) {
-    stockComposants[i] = produitsPlanifies[i] * produits[i].nbComp; // Initalisation du stock de composants nécessaires
-  }
   
   //
   //
   printf("== Initialisation du serveur %d...\n", (int) __pid);
   
   //
-  // Mémoire partagée
+  // Mémoire partagée et sémaphore de chaque anneau: mêmes recettes partout
   printf("==== Initialisation de la mémoire partagée\n");
-  
-  if ((__shmid = shmget(ftok(argv[1], ANNEAU_SHM_KEY), ANNEAU_SHM_SIZE, 0666)) == -1) {
-    __raise(-3, "======== ERROR: Impossible de se connecter à la mémoire partagé. Rassurez-vous que l'anneau est en cours de fonctionnement");
+  for (k = 0; k < nbAnneaux; k++) {
+    anneau_attacher(argv[1], k);
+    anneau_memoriser(&vues[k]);
+    nbCases[k] = __anneau->nbCases;
+    surveillances[k] = calloc(__anneau->nbRobots, sizeof(Battement));
+  
+    if (__anneau->nbProd != vues[0].anneau->nbProd || memcmp(__produits, vues[0].produits, __anneau->nbProd * sizeof(Produit)) != 0) {
+      __raise(-3, "======== ERROR: Les anneaux 0 et %d n'ont pas chargé les mêmes recettes", k);
+    }
   }
-  // Attachement à une adresse choisie par le système
-  if ((anneau_addr = shmat(__shmid, NULL, 0)) == (void *) -1) {
-    __raise(-4, "======== ERROR: Attachement impossible");
+  anneau_selectionner(&vues[0]);
+  
+  usine_init(&usine, __plan); // Initalisation du stock de composants nécessaires, plan chargé par l'anneau
+  usine.politique = politique;
+  printf("==== Politique d'injection: %s (%s)\n", politique->nom, politique->description);
+  usine.admission = admission;
+  printf("==== Admission: %s\n", admission_desc(&usine.admission));
+  usine.placement = typePlacement;
+  printf("==== Placement des robots: %s\n", placement_nom(usine.placement));
+  usine.roles.type = typeRoles;
+  printf("==== Rôles des robots: %s\n", roles_desc(&usine.roles));
+  
+  //
+  // Anneaux: même stock, admission et rôles propres à chacun
+  usine_ligne(&usine, nbAnneaux);
+  
+  if ((nbStations = stations_lire(stations, texteStations, nbCases, nbAnneaux)) < 0) {
+    __raise(-1, "Stations de transfert invalides: %s (A:pa-B:pb,... entre anneaux distincts, hors positions du serveur)", texteStations);
   }
-  printf("====== Connecté à la mémoire partagée %d\n", __shmid);
   
-  // Initialisation de l'anneau
-  __anneau = (Anneau *) anneau_addr;
+  if (nbAnneaux > 1) {
+    printf("==== Ligne de %d anneaux, stations de transfert:", nbAnneaux);
+    for (k = 0; k < nbStations; k++) {
+      printf(" %s", station_desc(&stations[k]));
+    }
+    printf("%s\n", nbStations ? "" : " aucune");
+  }
   
-  //
-  // Ouverture du sémaphore
-  __semaphore = sem_open(SEM_NAME, 0);
+  // Ports supplémentaires: mêmes positions sur chaque anneau
+  for (k = 1, casesMin = nbCases[0]; k < nbAnneaux; k++) {
+    casesMin = nbCases[k] < casesMin ? nbCases[k] : casesMin;
+  }
+  if (!ports_lire(&usine.ports, textePorts, casesMin)) {
+    __raise(-1, "Ports invalides: %s (i:N injection, e:N expédition, hors positions du serveur)", textePorts);
+  }
+  printf("==== Ports supplémentaires: %s\n", ports_desc(&usine.ports));
+}
+
+/**
+ * Traite les signaux en attente: appelée par la boucle principale
+ */
+void traiter_signaux() {
+  static struct timespec immediat = {0, 0};
+  static int s;
+  
+  while ((s = sigtimedwait(&signaux, NULL, &immediat)) > 0) {
+    switch (s) {
+      case SIGINT:
+      case SIGTERM:
+	callback_sigint_server(s);
+	break;
+    }
+  }
 }
 
 /**
  * Fonction de rappel SIGINT du serveur
  */
 void callback_sigint_server (int s) {
+  int k, sem_val;
+  
+  allocations_deverrouiller();
+  
+  // Aucun autre thread en plein traitement d'une rotation ou d'une requête
+  pthread_mutex_lock(&verrouLigne);
+  
   printf("==== Réception du signal SIGINT\n");
   printf("====== Interuption du processus en cours...\n");
   
-  // Déconnexion de l'anneau
-  __anneau->connexion[ANNEAU_POS_SERV_IN]  = 0;
-  __anneau->connexion[ANNEAU_POS_SERV_OUT] = 0;
-  printf("======== Serveur déconnecté de l'anneau\n");
+  for (k = 0; k < nbAnneaux; k++) {
+    anneau_selectionner(&vues[k]);
   
-  msgctl(__shmid, IPC_RMID, NULL);
-  printf("======== Déconnecté du segment (IPC)\n");
+    // Déconnexion de l'anneau
+    __connexions[ANNEAU_POS_SERV_IN]  = 0;
+    __connexions[ANNEAU_POS_SERV_OUT] = 0;
+    ports_brancher(&usine.ports, 0);
+    printf("======== Serveur déconnecté de l'anneau %d\n", k);
   
-  // Fermeture du sémaphore
-  int sem_val;
-  if (sem_getvalue(__semaphore, &sem_val) == 0) {
-    if (sem_val == 1) {
-      sem_post(__semaphore);
+    // Fermeture du sémaphore
+    if (sem_getvalue(__semaphore, &sem_val) == 0) {
+      if (sem_val == 1) {
+	sem_post(__semaphore);
+      }
     }
+    sem_close(__semaphore);
   }
-  sem_close(__semaphore);
+  anneau_selectionner(&vues[0]);
   
   //
-  // Arrêt du coordinateur
+  // Arrêt des coordinateurs
   printf("====== Interuption du coordinateur en cours...\n");
-  if (pthread_cancel(thread_id) != 0) {
-    printf("\n====== Échec d'interruption du coordinateur\n");
+  for (k = 0; k < nbAnneaux; k++) {
+    if (pthread_cancel(coordinateurs[k]) != 0) {
+      printf("\n====== Échec d'interruption du coordinateur de l'anneau %d\n", k);
+    }
   }
   
-  msgctl(msgid, IPC_RMID, NULL);
-  printf("====== File de message (IPC) supprimée\n");
+  journal_fermer();
   
-  printf("====== Libération de la mémoire\n");
-  if (produits) {
-    free(produits);
+  if (!planTermine) {
+    bilan();
+  }
+  
+  printf("====== Détachement de la mémoire partagée\n");
+  for (k = 0; k < nbAnneaux; k++) {
+    shmdt(vues[k].anneau);
   }
   
   __end_process();
@@ -138,147 +288,345 @@ void callback_sigint_server (int s) {
 }
 
 /**
- * Exécutée par le thread: Coordinateur
+ * Exécutée par le thread: Coordinateur de l'anneau numero
+ * Les requêtes sont attendues sans verrou, puis traitées avec les autres threads à tour de rôle
  */
-void callback_thread_coord(void *project) {
-  //
-  // File de message: Bus de communication entre le coordinateur et les robots
-  if ((msgid = msgget(ftok((char*) project, ANNEAU_SHM_KEY * __pid), IPC_CREAT | IPC_EXCL | 0666)) == -1) {
-    __raise(1, "======== ERROR: Impossible de créer la file de message !");
-  }
-  printf("====== File coord créée avec l'identificateur %d\n", msgid);
-  
-  //
-  // 
-  QueryConnexion q;
-  QueryConnexionResponse r;
-  int query_connexion_size = sizeof(QueryConnexion) - sizeof(long);
-  int query_connexion_response_size = sizeof(QueryConnexionResponse) - sizeof(long);
+void *callback_thread_coord(void *numero) {
+  RequeteControle q;
+  ReponseControle r;
   
-  int i;
+  anneau = (int) (long) numero;
+  anneau_selectionner(&vues[anneau]);
+  battements = surveillances[anneau];
   
   //
-  // Écoute
-  printf("====== Cordinateur à l'écoute...\n");
+  // Écoute: requêtes des robots déposées dans le segment partagé (voir controle_envoyer())
+  printf("====== Cordinateur%s à l'écoute...\n", desc_anneau());
   
   while (1) {
-    msgrcv(msgid, &q, query_connexion_size, __pid, 0);
+    pthread_testcancel();
     
-    switch (q.query) {
+    pthread_mutex_lock(&verrouLigne);
+    usine_anneau(&usine, anneau);
+    surveiller_robots();
+    pthread_mutex_unlock(&verrouLigne);
+    
+    if (!controle_recevoir(&q, DELAI_SIGNAUX_MS)) {
+      continue;
+    }
+    
+    pthread_mutex_lock(&verrouLigne);
+    usine_anneau(&usine, anneau);
+    
+    r.type = q.type;
+    r.pos  = q.bot.pos;
+    r.idx  = q.bot.idx;
+    
+    switch (q.type) {
       case COORD_MSG_HELLO:
-	printf("======> Connexion du robot R%d %d...\n", q.bot.id, (int) q.bot.pid);
+	printf("======> Connexion du robot R%d %d%s...\n", q.bot.id, (int) q.bot.pid, desc_anneau());
 	
 	r = callback_new_connexion(&q);
-	
-	msgsnd(msgid, &r, query_connexion_response_size, 0);
 	break;
 	
       case COORD_MSG_GOODBYE:
-	printf("<====== Déconnexion du robot R%d (%d)...\n", q.bot.id, (int) q.bot.pid);
+	printf("<====== Déconnexion du robot R%d (%d)%s...\n", q.bot.id, (int) q.bot.pid, desc_anneau());
+	
+	// Un robot refusé faute d'abonnement libre n'a pas été compté
+	if (q.bot.idx >= 0 && q.bot.idx < __anneau->nbRobots) {
+	  sem_wait(__semaphore);
+	  usine_robot(&usine, &q.bot, -1);
+	  sem_post(__semaphore);
+	}
+	pthread_mutex_unlock(&verrouLigne);
+	continue;
+	
+      case COORD_MSG_INFO:
+	if (q.bot.idx >= 0 && q.bot.idx < __anneau->nbRobots && __abonnes[q.bot.idx].pid == q.bot.pid) {
+	  r.pos = __abonnes[q.bot.idx].pos;
+	}
 	break;
     }
+    
+    pthread_mutex_unlock(&verrouLigne);
+    
+    if (!controle_repondre(q.boite, &r)) {
+      printf("====== Boîte de réponse %d pleine: réponse au robot R%d perdue\n", q.boite, q.bot.id);
+    }
   }
   
   pthread_exit(NULL);
 }
 
 /**
- * Fonction de rappel SIGUSR1 du serveur.
- * Exécutée après que l'anneau ai fait un pas de rotation
+ * Traitement d'une rotation par le serveur.
+ * Exécutée par la boucle principale après chaque pas de rotation de l'anneau
  */
-void callback_sigusr1_anneau_tourne(int s) {
-  static Case *case_in;
-  static Case *case_out;
-  static int j = 0;
-  static int i;
+void traiter_rotation() {
+  static ActionServeur a;
+  static __thread unsigned long long entree, demande, pris, sortie;
+  static int k;
   
+  entree = horloge();
+  latence_reveil(&__metriques->reveilServeur, tick.derniere, entree);
+  
+  pthread_mutex_lock(&verrouLigne);
+  usine_anneau(&usine, anneau);
+  
+  journal_debut();
+  demande = horloge();
   sem_wait(__semaphore);
+  pris = horloge();
   
-  case_in  = &(__anneau->cases[ANNEAU_POS_SERV_IN]);
-  case_out = &(__anneau->cases[ANNEAU_POS_SERV_OUT]);
+  a = usine_traiter(&usine, ya_til_des_robots_connectes());
   
-  sprintf(log, " ");
+  sem_post(__semaphore);
+  transferer();
+  sortie = horloge();
+  journal_fin();
   
-  // Si la case IN contient un produit
-  if (case_in->type == PRODUIT) {
-    // Si la fabrication de ce produit est terminée
-    if ((__anneau->cases[ANNEAU_POS_SERV_IN]).p.etat == -1) {
-      // Je le stocke
-      produitsFabriques[ctoi(case_in->p.num) - 1]++;
-      produitsPlanifies[ctoi(case_in->p.num) - 1]--;
-      sprintf(log, " Stock de %s", desc_case(case_in));
-      case_in->type = VIDE;
-    }
+  latence_fin(&__metriques->manqueesServeur, tick.derniere, sortie);
+  latence_ajouter(&__metriques->attenteServeur, pris - demande);
+  latence_ajouter(&__metriques->traitementServeur, sortie - entree);
+  
+  if (a.expedition) {
+    clock_gettime(CLOCK_MONOTONIC, &finProduction);
+    rotationFin = tick.derniere;
   }
   
-  // Distribution
-  if (ya_til_des_robots_connectes()) {
-    if (case_out->type == VIDE) {
-      if (nb_composants_restants() > 0) {
-	if (nb_cases_vides() > 3) {
-	  distri:
-	  if (j == NB_PROD) {
-	    j = 0;
-	  }
-	  if (stockComposants[j] == 0) {
-	    j++;
-	    goto distri;
-	  }
-	  
-	  case_out->c.num = itoc(j + 1);
-	  case_out->type = COMPOSANT;
-	  stockComposants[j]--;
-	  j++;
-	  
-	  strcat(log, " Distribution de ");
-	  strcat(log, desc_composant(&case_out->c));
-	}
-      } else {
-	strcat(log, " Stock épuisé");
+  if (a.injection && a.c.id == 1) {
+    clock_gettime(CLOCK_MONOTONIC, &debutProduction);
+    rotationDebut = tick.derniere;
+  }
+  
+  if (__sortie == SORTIE_TEXTE) {
+    decrire_action(&a);
+    info();
+  }
+  
+  // Fin du plan de production: en mode libre, la mesure est faite, la ligne s'arrête
+  if (!planTermine && usine_plan_termine(&usine)) {
+    planTermine = true;
+    bilan();
+    
+    for (k = 0; k < nbAnneaux; k++) {
+      if (vues[k].anneau->libre) {
+	kill(vues[k].anneau->id, SIGINT);
       }
     }
   }
   
-  sem_post(__semaphore);
+  pthread_mutex_unlock(&verrouLigne);
+}
+
+/**
+ * Stations de transfert au départ de l'anneau servi, après le traitement de sa rotation:
+ * sémaphores des deux anneaux pris, dans n'importe quel ordre puisque seul le serveur,
+ * sous verrouLigne, en prend deux à la fois
+ */
+void transferer() {
+  static Station *s;
+  static int i, sens;
+  
+  for (i = 0; i < nbStations; i++) {
+    s = &stations[i];
+  
+    for (sens = 0; sens < 2; sens++) {
+      if (s->anneaux[sens] != anneau) {
+	continue;
+      }
   
-  info();
+      sem_wait(vues[s->anneaux[0]].semaphore);
+      sem_wait(vues[s->anneaux[1]].semaphore);
+      station_traiter(s, vues, sens);
+      sem_post(vues[s->anneaux[1]].semaphore);
+      sem_post(vues[s->anneaux[0]].semaphore);
+    }
+  }
+}
+
+/**
+ * Précision de l'anneau servi par le thread, pour les messages: vide si la ligne n'en a qu'un
+ */
+char* desc_anneau() {
+  static __thread char str[DESC_TAILLE];
+  
+  if (nbAnneaux == 1) {
+    return "";
+  }
+  sprintf(str, " (anneau %d)", anneau);
+  return str;
 }
 
 /**
  * Fonction de rappel SIGUSR1: Connexion d'un nouveau robot
  */
-QueryConnexionResponse callback_new_connexion(QueryConnexion *q) {
-  static i;
-  static int iter = (int) (ANNEAU_NUM_CASES / NB_ROBOTS);
+ReponseControle callback_new_connexion(RequeteControle *q) {
+  ReponseControle r;
+  Abonne copie[__anneau->nbRobots];
+  int places[__anneau->nbRobots];
+  double trajet;
+  
+  r.type = q->type;
+  r.pos	 = anneau_position_libre();
+  
+  //
+  // Abonnement du robot aux rotations
+  sem_wait(__semaphore);
   
-  for (i = 0; i < ANNEAU_NUM_CASES; i += iter) {
-    if (__anneau->connexion[i] == 0) {
+  for (r.idx = 0; r.idx < __anneau->nbRobots; r.idx++) {
+    if (__abonnes[r.idx].pid == 0) {
+      __abonnes[r.idx].pid = q->bot.pid;
+      __abonnes[r.idx].pos = r.pos;
+      __abonnes[r.idx].acquitte = __abonnes[r.idx].reveil;
+      __abonnes[r.idx].marque = false;
+      __abonnes[r.idx].retarde = false;
+      metriques_robot_init(r.idx);
+      interet_tout(&__abonnes[r.idx].interet);
       break;
     }
   }
   
-  if (i > ANNEAU_NUM_CASES) {
-    for (i = ANNEAU_NUM_CASES; i >= 0; i--) {
-      if (__anneau->connexion[i] == 0) {
-	break;
-      }
+  // Capacités du robot enregistrées
+  if (r.idx < __anneau->nbRobots) {
+    q->bot.idx = r.idx;
+    usine_robot(&usine, &q->bot, 1);
+  
+    if (r.pos >= 0) {
+      __connexions[r.pos] = q->bot.pid;
     }
+    memcpy(copie, __abonnes, sizeof(copie));
   }
   
-  QueryConnexionResponse r;
-  r.type = q->bot.pid;
-  r.pos	 = i;
+  sem_post(__semaphore);
+  
+  // Robots replacés selon les gammes: le placement, exhaustif sur une petite ligne, est
+  // calculé sur la copie des abonnés, l'anneau n'est retenu que pour l'appliquer
+  if (r.idx < __anneau->nbRobots) {
+    trajet = usine_placement(&usine, copie, places);
+  
+    sem_wait(__semaphore);
+    usine_placement_appliquer(copie, places);
+    r.pos = __abonnes[r.idx].pos;
+    sem_post(__semaphore);
+  
+    afficher_placement(trajet);
+  }
   
   return r;
 }
 
+/**
+ * Affiche la position des robots abonnés et le trajet estimé par le placement
+ */
+void afficher_placement(double trajet) {
+  static int i;
+  
+  printf("====== Placement %s%s:", placement_nom(usine.placement), desc_anneau());
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid != 0) {
+      printf(" R%d=%d", __abonnes[i].id, __abonnes[i].pos);
+    }
+  }
+  printf(", trajet estimé %.1f rotations par produit\n", trajet);
+}
+
+/**
+ * Surveillance des robots par le coordinateur, au plus tous les DELAI_SIGNAUX_MS:
+ * un robot dont le battement de cœur n'avance plus est déclaré disparu et repris
+ */
+void surveiller_robots() {
+  static struct timespec maintenant;
+  static __thread struct timespec derniere; // Un coordinateur par anneau
+  static Abonne *a;
+  static long silence;
+  static int i;
+  
+  clock_gettime(CLOCK_MONOTONIC, &maintenant);
+  if ((maintenant.tv_sec - derniere.tv_sec) * 1000 + (maintenant.tv_nsec - derniere.tv_nsec) / 1000000 < DELAI_SIGNAUX_MS) {
+    return;
+  }
+  derniere = maintenant;
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    a = &(__abonnes[i]);
+    if (a->pid == 0) {
+      continue;
+    }
+  
+    // Nouvel abonné, ou battement depuis la dernière observation: robot vivant
+    if (battements[i].pid != a->pid || battements[i].battement != a->battement) {
+      battements[i].pid = a->pid;
+      battements[i].battement = a->battement;
+      battements[i].date = maintenant;
+      continue;
+    }
+  
+    // Silencieux: disparu si son processus est terminé, ou s'il est gelé depuis trop longtemps
+    silence = (maintenant.tv_sec - battements[i].date.tv_sec) * 1000 + (maintenant.tv_nsec - battements[i].date.tv_nsec) / 1000000;
+    if (silence >= SURVEILLANCE_GEL_MS
+      || (silence >= SURVEILLANCE_SILENCE_MS && kill(a->pid, 0) == -1 && errno == ESRCH)) {
+      reprendre_robot(i, silence);
+    }
+  }
+}
+
+/**
+ * Reprise du robot abonné en idx, déclaré disparu après silence ms sans battement
+ */
+void reprendre_robot(int idx, long silence) {
+  static Abonne *a;
+  static pid_t pid;
+  static double trajet;
+  static int i, rendus, degrades;
+  Abonne copie[__anneau->nbRobots];
+  int places[__anneau->nbRobots];
+  
+  a = &(__abonnes[idx]);
+  
+  sem_wait(__semaphore);
+  
+  pid = a->pid;
+  rendus = usine_reprendre(&usine, idx);
+  memcpy(copie, __abonnes, sizeof(copie));
+  
+  sem_post(__semaphore);
+  
+  // Robots restants replacés: placement calculé hors du sémaphore, sur la copie des abonnés
+  trajet = usine_placement(&usine, copie, places);
+  
+  sem_wait(__semaphore);
+  usine_placement_appliquer(copie, places);
+  sem_post(__semaphore);
+  
+  // Boîte de réponse du robot rendue au canal de contrôle
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__boites[i].pid == pid) {
+      controle_fermer_boite(i);
+    }
+  }
+  
+  printf("<====== Robot R%d (%d)%s disparu, sans battement depuis %ld ms: %d composants de son stock à réinjecter\n", a->id, (int) pid, desc_anneau(), silence, rendus);
+  
+  printf("====== Robots en mode dégradé:");
+  for (i = 0, degrades = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid != 0 && __abonnes[i].mode == DEGRADE) {
+      printf(" R%d", __abonnes[i].id);
+      degrades++;
+    }
+  }
+  printf("%s\n", degrades ? "" : " aucun");
+  
+  afficher_placement(trajet);
+}
+
 /**
  * c'est pas assez clair le nom de la fonction ? :)
  */
 bool ya_til_des_robots_connectes() {
   static int i;
-  for (i = 0; i < NB_ROBOTS; i++) {
-    if (__anneau->connexion[i] != 0 && __anneau->connexion[i] != __pid) {
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid != 0) {
       return true;
     }
   }
@@ -286,44 +634,127 @@ bool ya_til_des_robots_connectes() {
 }
 
 /**
- * c'est pas assez clair le nom de la fonction ? :)
+ * Affiche le bilan de production: composants injectés, produits fabriqués,
+ * durée de fabrication et débit de l'anneau
  */
-bool puis_je_prendre_produit() {
-  // Si le produit est terminée
-  if ((__anneau->cases[ANNEAU_POS_SERV_IN]).p.etat == -1) {
-    return true;
+void bilan() {
+  static double duree;
+  static unsigned int rotations;
+  static int i, k;
+  
+  duree = (finProduction.tv_sec - debutProduction.tv_sec) + (finProduction.tv_nsec - debutProduction.tv_nsec) / 1e9;
+  rotations = rotationFin - rotationDebut;
+  
+  if (usine.numeroSerie == 0 || duree < 0) {
+    duree = 0;
+    rotations = 0;
   }
-  return false;
+  
+  printf("==== Bilan de production%s\n", planTermine ? ": plan terminé" : " (plan inachevé)");
+  printf("====== Politique d'injection: %s\n", usine.politique->nom);
+  
+  // Admission et rôles de chaque anneau
+  for (k = 0; k < nbAnneaux; k++) {
+    usine_anneau(&usine, k);
+    if (nbAnneaux > 1) {
+      printf("====== Anneau %d\n", k);
+    }
+    printf("====== Admission           : %s\n", admission_desc(&usine.admission));
+    printf("====== Rôles               : %s\n", roles_desc(&usine.roles));
+  }
+  usine_anneau(&usine, anneau);
+  
+  printf("====== Placement           : %s\n", placement_nom(usine.placement));
+  printf("====== Ports supplémentaires: %s\n", ports_desc(&usine.ports));
+  for (k = 0; k < nbStations; k++) {
+    printf("====== Station %-12s: %d transferts de l'anneau %d, %d de l'anneau %d\n", station_desc(&stations[k]),
+	   stations[k].transferts[0], stations[k].anneaux[0], stations[k].transferts[1], stations[k].anneaux[1]);
+  }
+  printf("====== Composants injectés : %d\n", usine.numeroSerie);
+  printf("====== Produits fabriqués  :");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf(" P%d=%d", i + 1, usine.produitsFabriques[i]);
+  }
+  printf("\n");
+  printf("====== Durée de fabrication: %.3f s, %u rotations", duree, rotations);
+  if (duree > 0) {
+    printf(", %.0f rotations/s", rotations / duree);
+  }
+  printf("\n");
+  printf("====== Délai moyen         : %.1f rotations\n", usine_delai_moyen(&usine));
+  fflush(stdout);
 }
 
 /**
- * Retourne le nombre de composants restants en stock
+ * Rédige le message du tableau de bord à partir de l'action effectuée
  */
-int nb_composants_restants() {
-  static int i, num;
-  for (i = 0, num = 0; i < NB_PROD; i++) {
-    num += stockComposants[i];
+void decrire_action(ActionServeur *a) {
+  sprintf(log, " ");
+  
+  if (a->expedition) {
+    sprintf(log, " Stock de %s", desc_produit(&a->p));
+  }
+  
+  if (a->injection) {
+    strcat(log, " Distribution de ");
+    strcat(log, desc_composant(&a->c));
+  } else if (a->epuise) {
+    strcat(log, " Stock épuisé");
   }
-  return num;
 }
 
 /**
  * Affichage des informations du serveur
  */
 void info() {
+  static int i;
+  
+  if (__sortie != SORTIE_TEXTE) {
+    return;
+  }
+  
   printf("⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯[Server]⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯\n");
   printf("             PID : %d\n", (int) __pid);
+  if (nbAnneaux > 1) {
+    printf("          Anneau : %d sur %d, %d stations de transfert\n", anneau, nbAnneaux, nbStations);
+  }
+  printf("       Injection : %s\n", usine.politique->nom);
+  printf("       Admission : %s\n", admission_desc(&usine.admission));
+  printf("         Encours : %d\n", usine.encours);
+  printf("       Placement : %s\n", placement_nom(usine.placement));
+  printf("           Rôles : %s\n", roles_desc(&usine.roles));
   
   printf("⎬⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯[état in/out]⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎨\n");
-  printf("              IN : %s\n", desc_case(&(__anneau->cases[ANNEAU_POS_SERV_IN])));
-  printf("             OUT : %s\n\n", desc_case(&(__anneau->cases[ANNEAU_POS_SERV_OUT])));
+  printf("              IN : %s\n", desc_case(anneau_case(ANNEAU_POS_SERV_IN)));
+  printf("             OUT : %s\n", desc_case(anneau_case(ANNEAU_POS_SERV_OUT)));
+  for (i = 0; i < usine.ports.nbExpeditions; i++) {
+    printf("         IN %4d : %s\n", usine.ports.expeditions[i], desc_case(anneau_case(usine.ports.expeditions[i])));
+  }
+  for (i = 0; i < usine.ports.nbInjections; i++) {
+    printf("        OUT %4d : %s\n", usine.ports.injections[i], desc_case(anneau_case(usine.ports.injections[i])));
+  }
+  printf("\n");
   
   printf("⎬⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯[stats]⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯⎨\n\n");
-  printf("                      1   2   3   4\n");
-  printf("  Stock composants : %2d  %2d  %2d  %2d\n", stockComposants[0], stockComposants[1], stockComposants[2], stockComposants[3]);
-  printf(" Produits planifés : %2d  %2d  %2d  %2d\n", produitsPlanifies[0], produitsPlanifies[1], produitsPlanifies[2], produitsPlanifies[3]);
-  printf("Produits fabriqués : %2d  %2d  %2d  %2d\n\n\n", produitsFabriques[0], produitsFabriques[1], produitsFabriques[2], produitsFabriques[3]);
-  printf("   %s\n\n\n", log);
+  printf("                   ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("  %2d", i + 1);
+  }
+  printf("\n  Stock composants : ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("%2d  ", usine.stockComposants[i]);
+  }
+  printf("\n Produits planifés : ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("%2d  ", usine.produitsPlanifies[i]);
+  }
+  printf("\nProduits fabriqués : ");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf("%2d  ", usine.produitsFabriques[i]);
+  }
+  printf("\n\n\n");
+  printf("   %s\n\n", log);
+  printf("  Rotations : %lu traitées, %lu manquées, retard %u (max %u)\n\n\n", tick.traites, tick.manques, tick.retard, tick.retardMax);
 }
 
 
@@ -3,6 +3,20 @@
 /********************************/
 
 #include "common.c"
+#include "journal.c"
+#include "atelier.c"
+
+#define SURVEILLANCE_SILENCE_MS	1000	// Robot sans battement depuis ce délai et processus terminé: disparu
+#define SURVEILLANCE_GEL_MS	5000	// Robot sans battement depuis ce délai, même si le processus existe: disparu
+
+/**
+ * Structure Battement: dernier battement de cœur vu par le coordinateur, par abonnement
+ */
+typedef struct {
+  pid_t pid;			// Robot abonné lors de la dernière observation
+  unsigned int battement;
+  struct timespec date;		// Date du dernier changement observé
+} Battement;
 
 /**
  * Global vars: définis dans le fichier common.h
@@ -12,26 +26,60 @@
  * @var *__semaphore: Sémaphore de synchronisation de l'anneau
  */
 
-int msgid; // Identifiant de la file de message
+int nbAnneaux = 1; // Anneaux de la ligne servis par le serveur (--anneaux)
+VueAnneau vues[NB_ANNEAUX_MAX]; // Anneaux attachés
+static char *texteStations = ""; // Stations de transfert entre les anneaux (--stations)
+static char *textePorts = ""; // Ports supplémentaires d'injection et d'expédition (--ports)
+Station stations[NB_STATIONS_MAX];
+int nbStations;
+
+pthread_t coordinateurs[NB_ANNEAUX_MAX]; // Un coordinateur par anneau
+pthread_t servants[NB_ANNEAUX_MAX]; // Traitement des rotations des anneaux suivants (le premier: boucle principale)
+pthread_mutex_t verrouLigne = PTHREAD_MUTEX_INITIALIZER; // Stock et tableaux de bord communs aux anneaux: un thread à la fois
+__thread int anneau; // Anneau servi par le thread
 
-pthread_t thread_id; // ID du thread (coordinateur)
+Usine usine; // Plan de production et stocks
+const PolitiqueInjection *politique; // Politique d'injection choisie au lancement (--injection)
+Admission admission; // Règle d'admission choisie au lancement (--admission)
+TypePlacement typePlacement; // Placement des robots choisi au lancement (--placement)
+TypeRoles typeRoles; // Pilotage des rôles des robots choisi au lancement (--roles)
 
-Produit *produits; // Liste de profils des produits
-int produitsPlanifies[NB_PROD] = {10, 15, 12, 8}; // Nombre de produits à fabriquer
-int produitsFabriques[NB_PROD] = {0}; // Nombre de produits fabriqués
-int stockComposants[NB_PROD]; // Stock de composants = produitsPlanifies * produitsFabriques
+Battement *surveillances[NB_ANNEAUX_MAX]; // Surveillance des robots de chaque anneau, par abonnement
+__thread Battement *battements; // Celle de l'anneau du coordinateur
 
 static char log[100]; // Utiliser pour info()
 
+sigset_t signaux; // Signaux traités par la boucle principale
+__thread Cadencement tick; // Suivi des rotations traitées de l'anneau servi
+
+struct timespec debutProduction, finProduction; // Première injection, dernière expédition
+unsigned int rotationDebut, rotationFin;	 // Générations correspondantes
+bool planTermine = false;
+
 /**
  * Initialisation principale
  */
 void init(char **argv);
 
 /**
- * Exécutée par le thread: Coordinateur
+ * Exécutée par le thread: Coordinateur de l'anneau numero
  */
-void callback_thread_coord(void *project);
+void *callback_thread_coord(void *numero);
+
+/**
+ * Exécutée par le thread qui sert l'anneau numero (anneaux suivant le premier)
+ */
+void *callback_thread_anneau(void *numero);
+
+/**
+ * Boucle d'événements du thread qui sert l'anneau k: rotations, et signaux pour le premier
+ */
+void servir_anneau(int k);
+
+/**
+ * Traite les signaux en attente: appelée par la boucle principale
+ */
+void traiter_signaux();
 
 /**
  * Fonction de rappel SIGINT du serveur
@@ -44,36 +92,63 @@ void callback_sigint_server (int);
 void callback_sigint_coord (int);
 
 /**
- * Fonction de rappel SIGUSR1 du serveur.
- * Exécutée après que l'anneau ai fait un pas de rotation
+ * Traitement d'une rotation par le serveur.
+ * Exécutée par la boucle principale après chaque pas de rotation de l'anneau
+ */
+void traiter_rotation();
+
+/**
+ * Stations de transfert au départ de l'anneau servi, après le traitement de sa rotation
+ */
+void transferer();
+
+/**
+ * Précision de l'anneau servi par le thread, pour les messages: vide si la ligne n'en a qu'un
  */
-void callback_sigusr1_anneau_tourne(int);
+char* desc_anneau();
 
 /**
  * Fonction de rappel SIGUSR1: Connexion d'un nouveau robot
  */
-QueryConnexionResponse callback_new_connexion(QueryConnexion *);
+ReponseControle callback_new_connexion(RequeteControle *);
 
 /**
- * c'est pas assez clair le nom de la fonction ? :)
+ * Affiche la position des robots abonnés et le trajet estimé par le placement
  */
-bool ya_til_des_robots_connectes();
+void afficher_placement(double trajet);
+
+/**
+ * Surveillance des robots par le coordinateur, au plus tous les DELAI_SIGNAUX_MS:
+ * un robot dont le battement de cœur n'avance plus est déclaré disparu et repris
+ */
+void surveiller_robots();
+
+/**
+ * Reprise du robot abonné en idx, déclaré disparu après silence ms sans battement
+ */
+void reprendre_robot(int idx, long silence);
 
 /**
  * c'est pas assez clair le nom de la fonction ? :)
  */
-bool puis_je_prendre_produit();
+bool ya_til_des_robots_connectes();
 
 /**
- * Retourne le nombre de composants restants en stock
+ * Affiche le bilan de production: composants injectés, produits fabriqués,
+ * durée de fabrication et débit de l'anneau
  */
-int nb_composants_restants();
+void bilan();
 
 /**
  * Envoie le signal s aux robots connectés à l'anneau
  */
 void send_signal_to_bots(int s);
 
+/**
+ * Rédige le message du tableau de bord à partir de l'action effectuée
+ */
+void decrire_action(ActionServeur *a);
+
 /**
  * Affichage des informations du serveur
  */
@@ -0,0 +1,556 @@
+#include "simulation.h"
+
+/**
+ * Global vars: définis dans le fichier simulation.h
+ * @var VueAnneau vues[]		Anneaux de la ligne (option --anneaux=)
+ * @var Station stations[]		Stations de transfert entre les anneaux (option --stations=)
+ * @var Usine usine			Plan de production et stocks du serveur
+ * @var Poste *postes			Robots, dans l'ordre des abonnements
+ * @var int nbPostes			Nombre de robots
+ * @var unsigned int rotationDebut	Génération de la première injection
+ * @var unsigned int rotationFin	Génération de la dernière expédition
+ * @var unsigned int rotationActivite	Génération de la dernière injection ou expédition
+ */
+
+int main(int argc, char *argv[]) {
+  static Scenario scenario;
+  static Produit recettes[NB_PROD_MAX];
+  static int plan[NB_PROD_MAX];
+  char *fichier = NULL, *texte = NULL, *fichierRecettes = RECETTES_FICHIER, *injection = "tourniquet", *admission = "seuil", *placement = "flux", *roles = "fixes", *texteStations = "", *textePorts = "";
+  int nbCases = ANNEAU_NUM_CASES;
+  int nbCasesAnneaux[NB_ANNEAUX_MAX];
+  int nbProd, k;
+  int rotationsMax = SIMULATION_ROTATIONS_MAX;
+  int regressions = 0;
+  TypePlacement typePlacement;
+  Ports ports;
+  Performances perf;
+  struct timespec debut, fin;
+  
+  argc = lire_option_entier(argc, argv, "--cases=", &nbCases);
+  argc = lire_option_entier(argc, argv, "--anneaux=", &nbAnneaux);
+  argc = lire_option_chaine(argc, argv, "--stations=", &texteStations);
+  argc = lire_option_chaine(argc, argv, "--ports=", &textePorts);
+  argc = lire_option_entier(argc, argv, "--rotations=", &rotationsMax);
+  argc = lire_option_chaine(argc, argv, "--plan=", &texte);
+  argc = lire_option_chaine(argc, argv, "--recettes=", &fichierRecettes);
+  argc = lire_option_chaine(argc, argv, "--injection=", &injection);
+  argc = lire_option_chaine(argc, argv, "--admission=", &admission);
+  argc = lire_option_chaine(argc, argv, "--placement=", &placement);
+  argc = lire_option_chaine(argc, argv, "--roles=", &roles);
+  argc = lire_option_chaine(argc, argv, "--scenario=", &fichier);
+  
+  if (nbCases < 2 || rotationsMax < 1 || (fichier && argc > 1)) {
+    __raise(-1, "Usage: %s [--cases=N] [--anneaux=N] [--stations=A:pa-B:pb,...] [--ports=i:N,e:N,...] [--rotations=N] [--recettes=FICHIER] [--plan=n1,n2,...] [--injection=POLITIQUE] [--admission=REGLE[:N]] [--placement=flux|regulier] [--roles=fixes|adaptatifs] [id:ops:produits:produits_dégradés[:anneau] ...]\n"
+	"       %s [--rotations=N] --scenario=FICHIER", argv[0], argv[0]);
+  }
+  
+  //
+  // Configuration: scénario, ou ligne de commande et robots de install.sh si aucun n'est donné
+  snprintf(scenario.recettes, sizeof(scenario.recettes), "%s", fichierRecettes);
+  snprintf(scenario.injection, sizeof(scenario.injection), "%s", injection);
+  snprintf(scenario.admission, sizeof(scenario.admission), "%s", admission);
+  snprintf(scenario.placement, sizeof(scenario.placement), "%s", placement);
+  snprintf(scenario.roles, sizeof(scenario.roles), "%s", roles);
+  snprintf(scenario.stations, sizeof(scenario.stations), "%s", texteStations);
+  snprintf(scenario.ports, sizeof(scenario.ports), "%s", textePorts);
+  
+  if (fichier) {
+    lire_scenario(fichier, &scenario);
+    printf("== Scénario %s\n", fichier);
+  } else {
+    scenario.nbCases = nbCases;
+    scenario.nbAnneaux = nbAnneaux > 0 ? nbAnneaux : 1;
+  
+    if (texte) {
+      scenario.nbPlan = lire_plan(texte, scenario.plan);
+    }
+  
+    if (argc > 1) {
+      scenario.nbRobots = argc - 1;
+      memcpy(scenario.pRobots, argv + 1, scenario.nbRobots * sizeof(char *));
+    } else {
+      scenario.nbRobots = sizeof(robotsParDefaut) / sizeof(robotsParDefaut[0]);
+      memcpy(scenario.pRobots, robotsParDefaut, sizeof(robotsParDefaut));
+    }
+  }
+  
+  //
+  // Recettes, plan du fichier sauf s'il est remplacé
+  nbProd = lire_recettes(scenario.recettes, recettes, plan);
+  
+  if (scenario.nbPlan > nbProd) {
+    __raise(-3, "Plan invalide: %d produits dans %s", nbProd, scenario.recettes);
+  }
+  if (scenario.nbPlan > 0) {
+    memcpy(plan, scenario.plan, sizeof(plan));
+  }
+  
+  if (!placement_lire(&typePlacement, scenario.placement)) {
+    __raise(-3, "Placement inconnu: %s (flux ou regulier)", scenario.placement);
+  }
+  
+  if (!ports_lire(&ports, scenario.ports, scenario.nbCases)) {
+    __raise(-3, "Ports invalides: %s (i:N injection, e:N expédition, hors positions du serveur)", scenario.ports);
+  }
+  if (scenario.nbAnneaux < 1 || scenario.nbAnneaux > NB_ANNEAUX_MAX) {
+    __raise(-3, "Nombre d'anneaux invalide: %d (1 à %d)", scenario.nbAnneaux, NB_ANNEAUX_MAX);
+  }
+  
+  nbAnneaux = scenario.nbAnneaux;
+  nbPostes = scenario.nbRobots;
+  init(scenario.nbCases, nbProd, recettes, plan, typePlacement, &ports, scenario.pRobots);
+  
+  if ((usine.politique = politique_injection(scenario.injection)) == NULL) {
+    printf("Politiques d'injection:\n");
+    politiques_injection_lister();
+    __raise(-3, "Politique d'injection inconnue: %s", scenario.injection);
+  }
+  if (!admission_lire(&usine.admission, scenario.admission)) {
+    __raise(-3, "Règle d'admission invalide: %s (seuil, conwip, occupation ou retroaction[:N])", scenario.admission);
+  }
+  if (!roles_lire(&usine.roles.type, scenario.roles)) {
+    __raise(-3, "Pilotage des rôles inconnu: %s (fixes ou adaptatifs)", scenario.roles);
+  }
+  
+  //
+  // Ligne: admission et rôles de départ identiques sur chaque anneau, stations entre anneaux
+  usine_ligne(&usine, nbAnneaux);
+  
+  for (k = 0; k < nbAnneaux; k++) {
+    nbCasesAnneaux[k] = scenario.nbCases;
+  }
+  if ((nbStations = stations_lire(stations, scenario.stations, nbCasesAnneaux, nbAnneaux)) < 0) {
+    __raise(-3, "Stations de transfert invalides: %s (A:pa-B:pb,... entre anneaux distincts, hors positions du serveur)", scenario.stations);
+  }
+  
+  if (nbAnneaux > 1) {
+    printf("== Ligne de %d anneaux, stations:", nbAnneaux);
+    for (k = 0; k < nbStations; k++) {
+      printf(" %s", station_desc(&stations[k]));
+    }
+    printf("%s\n", nbStations ? "" : " aucune");
+  }
+  
+  printf("== Simulation: %d cases, %d robots, injection %s, admission %s, placement %s, rôles %s, ports %s\n", scenario.nbCases, nbPostes, usine.politique->nom, scenario.admission, placement_nom(usine.placement), scenario.roles, ports_desc(&usine.ports));
+  
+  //
+  // Rotations jusqu'à la fin du plan de production
+  clock_gettime(CLOCK_MONOTONIC, &debut);
+  
+  while (!usine_plan_termine(&usine) && __anneau->generation < (unsigned int) rotationsMax) {
+    tourner();
+    
+    if (__anneau->generation - rotationActivite > SIMULATION_BLOCAGE) {
+      printf("==== Ligne bloquée: aucune injection ni expédition depuis %d rotations\n", SIMULATION_BLOCAGE);
+      break;
+    }
+  }
+  
+  clock_gettime(CLOCK_MONOTONIC, &fin);
+  
+  perf = mesurer();
+  bilan(&perf, (fin.tv_sec - debut.tv_sec) + (fin.tv_nsec - debut.tv_nsec) / 1e9);
+  
+  if (fichier) {
+    regressions = comparer(&scenario, &perf);
+  }
+  
+  free(postes);
+  for (k = 0; k < nbAnneaux; k++) {
+    free(vues[k].anneau);
+  }
+  return regressions > 0;
+}
+
+/**
+ * Construit les nbAnneaux anneaux, branche le serveur à chacun, avec ses ports supplémentaires,
+ * et les robots décrits par robots[] à leur anneau, placés selon placement
+ */
+void init(int nbCases, int nbProd, Produit *recettes, const int *plan, TypePlacement placement, Ports *ports, char **robots) {
+  char ops[SCENARIO_LIGNE], prods[SCENARIO_LIGNE], prodsDegrades[SCENARIO_LIGNE];
+  int robotsAnneau[NB_ANNEAUX_MAX] = {0};
+  double trajets[NB_ANNEAUX_MAX] = {0};
+  int *anneaux; // Anneau de chaque robot
+  int i, j, k, id;
+  Abonne *a;
+  
+  __pid = getpid();
+  
+  //
+  // Robots: anneau de chacun, qui dimensionne les abonnements de son anneau
+  postes = calloc(nbPostes, sizeof(Poste));
+  anneaux = calloc(nbPostes, sizeof(int));
+  
+  for (i = 0; i < nbPostes; i++) {
+    if (sscanf(robots[i], "%d:%127[^:]:%127[^:]:%127[^:]:%d", &id, ops, prods, prodsDegrades, &anneaux[i]) < 4
+	|| anneaux[i] < 0 || anneaux[i] >= nbAnneaux) {
+      __raise(-2, "Robot invalide: %s (attendu id:ops:produits:produits_dégradés[:anneau], %d anneaux)", robots[i], nbAnneaux);
+    }
+    robotsAnneau[anneaux[i]]++;
+  }
+  
+  //
+  // Anneaux: même disposition que le segment partagé, serveur branché sur chacun
+  for (k = 0; k < nbAnneaux; k++) {
+    __anneau = calloc(1, anneau_taille(nbCases, robotsAnneau[k], nbProd));
+  
+    __anneau->id 		= __pid;
+    __anneau->numero 	= k;
+    __anneau->nbCases 	= nbCases;
+    __anneau->nbRobots 	= robotsAnneau[k];
+    __anneau->nbProd 	= nbProd;
+    __anneau->taille 	= anneau_taille(nbCases, robotsAnneau[k], nbProd);
+    __anneau->libre 	= true; // Marquage des robots concernés sans réveil
+  
+    anneau_geometrie();
+    anneau_recettes(recettes, plan);
+  
+    for (i = 0; i < nbCases; i++) {
+      __cases[i].num  = i;
+      __cases[i].type = VIDE;
+    }
+    metriques_init();
+  
+    __connexions[ANNEAU_POS_SERV_IN]  = __pid;
+    __connexions[ANNEAU_POS_SERV_OUT] = __pid;
+    ports_brancher(ports, __pid);
+    anneau_memoriser(&vues[k]);
+  }
+  
+  anneau_selectionner(&vues[0]);
+  usine_init(&usine, __plan);
+  usine.placement = placement;
+  usine.ports = *ports;
+  
+  //
+  // Robots: connectés dans l'ordre, comme par le coordinateur, qui replace les robots de l'anneau à chaque connexion
+  memset(robotsAnneau, 0, sizeof(robotsAnneau));
+  
+  for (i = 0; i < nbPostes; i++) {
+    k = anneaux[i];
+    anneau_selectionner(&vues[k]);
+  
+    sscanf(robots[i], "%d:%127[^:]:%127[^:]:%127[^:]", &id, ops, prods, prodsDegrades);
+    poste_init(&postes[i], id, ops, prods, prodsDegrades);
+    postes[i].bot.pid = __pid;
+    postes[i].bot.anneau = k;
+    postes[i].bot.idx = robotsAnneau[k]++;
+    postes[i].bot.pos = anneau_position_libre();
+    __connexions[postes[i].bot.pos] = __pid;
+  
+    a = &(__abonnes[postes[i].bot.idx]);
+    a->pid = __pid;
+    a->pos = postes[i].bot.pos;
+    interet_tout(&a->interet);
+  
+    usine_robot(&usine, &postes[i].bot, 1);
+    trajets[k] = usine_placer(&usine);
+  
+    for (j = 0; j <= i; j++) {
+      if (postes[j].bot.anneau == k) {
+	postes[j].bot.pos = __abonnes[postes[j].bot.idx].pos;
+      }
+    }
+  
+    printf("==== Robot %d connecté en %d", postes[i].bot.id, postes[i].bot.pos);
+    if (nbAnneaux > 1) {
+      printf(" (anneau %d)", k);
+    }
+    printf("\n");
+  }
+  
+  for (k = 0; k < nbAnneaux; k++) {
+    printf("==== Placement %s", placement_nom(usine.placement));
+    if (nbAnneaux > 1) {
+      printf(" (anneau %d)", k);
+    }
+    printf(":");
+    for (i = 0; i < nbPostes; i++) {
+      if (postes[i].bot.anneau == k) {
+	printf(" R%d=%d", postes[i].bot.id, postes[i].bot.pos);
+      }
+    }
+    printf(", trajet estimé %.1f rotations par produit\n", trajets[k]);
+  }
+  
+  free(anneaux);
+  anneau_selectionner(&vues[0]);
+}
+
+/**
+ * Une rotation de chaque anneau: l'anneau tourne, le serveur puis les robots concernés
+ * la traitent, dans l'ordre fixé par anneau_relayer_rotation() en mode libre; les
+ * stations au départ de l'anneau transfèrent après le serveur, comme transferer()
+ */
+void tourner() {
+  static ActionServeur s;
+  static unsigned int g;
+  static Abonne *a;
+  static int i, k, sens;
+  
+  for (k = 0; k < nbAnneaux; k++) {
+    anneau_selectionner(&vues[k]);
+    usine_anneau(&usine, k);
+  
+    __anneau->tete = (__anneau->tete + 1) % __anneau->nbCases;
+    g = anneau_marquer_abonnes();
+  
+    //
+    // Serveur
+    s = usine_traiter(&usine, __anneau->nbRobots > 0);
+  
+    if (s.injection && s.c.id == 1) {
+      rotationDebut = g;
+    }
+    if (s.expedition) {
+      rotationFin = g;
+    }
+    if (s.injection || s.expedition) {
+      rotationActivite = g;
+    }
+  
+    for (i = 0; i < nbStations; i++) {
+      for (sens = 0; sens < 2; sens++) {
+	if (stations[i].anneaux[sens] == k) {
+	  station_traiter(&stations[i], vues, sens);
+	}
+      }
+    }
+  
+    //
+    // Rôles et modes imposés par le serveur: appliqués avant la rotation suivante
+    for (i = 0; i < nbPostes; i++) {
+      a = &(__abonnes[postes[i].bot.idx]);
+      if (postes[i].bot.anneau == k && poste_consignes_changees(&postes[i], a)) {
+	poste_suivre(&postes[i], a);
+	poste_publier(&postes[i], a);
+      }
+    }
+  
+    //
+    // Robots de l'anneau concernés par la case devant eux
+    for (i = 0; i < nbPostes; i++) {
+      a = &(__abonnes[postes[i].bot.idx]);
+      if (postes[i].bot.anneau == k && a->marque) {
+	a->marque = false;
+  
+	poste_traiter(&postes[i]);
+	poste_publier(&postes[i], a);
+      }
+    }
+  }
+  
+  anneau_selectionner(&vues[0]);
+  usine_anneau(&usine, 0);
+}
+
+/**
+ * Lit un plan de production "n1,n2,..." (un nombre par produit)
+ * et retourne le nombre de produits
+ */
+int lire_plan(const char *texte, int *plan) {
+  char *fin;
+  int i;
+  
+  for (i = 0; i < NB_PROD_MAX; i++) {
+    plan[i] = 0;
+  }
+  
+  for (i = 0; *texte; i++) {
+    if (i == NB_PROD_MAX) {
+      __raise(-3, "Plan invalide: %d produits au plus", NB_PROD_MAX);
+    }
+  
+    plan[i] = strtol(texte, &fin, 10);
+  
+    if (fin == texte || plan[i] < 0 || (*fin != ',' && *fin != '\0')) {
+      __raise(-3, "Plan invalide: %s (attendu n1,n2,...)", texte);
+    }
+    texte = *fin == ',' ? fin + 1 : fin;
+  }
+  
+  return i;
+}
+
+/**
+ * Charge un fichier de scénario: lignes cle=valeur, # en début de commentaire
+ *   cases=16  recettes=FICHIER  plan=10,15,12,8  injection=POLITIQUE  admission=REGLE  placement=flux  roles=fixes
+ *   anneaux=2  stations=0:8-1:8 (ligne de plusieurs anneaux)
+ *   robot=id:ops:produits:produits_dégradés[:anneau] (une ligne par robot)
+ *   fabriques=N  duree=N  cadence=X  delai=X  tolerance=X (valeurs de référence et écart admis en %)
+ *   inacheve=1 (plan inachevé attendu)
+ */
+void lire_scenario(const char *fichier, Scenario *s) {
+  char ligne[SCENARIO_LIGNE], cle[SCENARIO_LIGNE], valeur[SCENARIO_LIGNE];
+  FILE *f;
+  int n;
+  
+  if ((f = fopen(fichier, "r")) == NULL) {
+    __raise(-4, "Scénario %s: %s", fichier, strerror(errno));
+  }
+  
+  s->nbCases = ANNEAU_NUM_CASES;
+  s->nbAnneaux = 1;
+  s->nbRobots = 0;
+  s->tolerance = SCENARIO_TOLERANCE;
+  s->inacheve = false;
+  
+  for (n = 1; fgets(ligne, sizeof(ligne), f); n++) {
+    if (ligne[0] == '#' || sscanf(ligne, " %127[^= \t] = %127s", cle, valeur) != 2) {
+      continue;
+    }
+  
+    if (strcmp(cle, "cases") == 0) {
+      s->nbCases = atoi(valeur);
+    } else if (strcmp(cle, "anneaux") == 0) {
+      s->nbAnneaux = atoi(valeur);
+    } else if (strcmp(cle, "stations") == 0) {
+      snprintf(s->stations, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "ports") == 0) {
+      snprintf(s->ports, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "recettes") == 0) {
+      snprintf(s->recettes, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "injection") == 0) {
+      snprintf(s->injection, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "admission") == 0) {
+      snprintf(s->admission, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "placement") == 0) {
+      snprintf(s->placement, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "roles") == 0) {
+      snprintf(s->roles, SCENARIO_LIGNE, "%s", valeur);
+    } else if (strcmp(cle, "plan") == 0) {
+      s->nbPlan = lire_plan(valeur, s->plan);
+    } else if (strcmp(cle, "robot") == 0 && s->nbRobots < SCENARIO_ROBOTS_MAX) {
+      snprintf(s->robots[s->nbRobots], SCENARIO_LIGNE, "%s", valeur);
+      s->pRobots[s->nbRobots] = s->robots[s->nbRobots];
+      s->nbRobots++;
+    } else if (strcmp(cle, "fabriques") == 0) {
+      s->reference.fabriques = atoi(valeur);
+    } else if (strcmp(cle, "duree") == 0) {
+      s->reference.duree = atoi(valeur);
+    } else if (strcmp(cle, "cadence") == 0) {
+      s->reference.cadence = atof(valeur);
+    } else if (strcmp(cle, "delai") == 0) {
+      s->reference.delai = atof(valeur);
+    } else if (strcmp(cle, "tolerance") == 0) {
+      s->tolerance = atof(valeur);
+    } else if (strcmp(cle, "inacheve") == 0) {
+      s->inacheve = atoi(valeur) != 0;
+    } else {
+      __raise(-4, "Scénario %s, ligne %d: clé inconnue %s", fichier, n, cle);
+    }
+  }
+  
+  fclose(f);
+  
+  if (s->nbCases < 2 || s->nbRobots == 0) {
+    __raise(-4, "Scénario %s: au moins 2 cases et un robot", fichier);
+  }
+}
+
+/**
+ * Calcule les performances de la simulation terminée
+ */
+Performances mesurer() {
+  Performances perf;
+  int i;
+  
+  for (i = 0, perf.fabriques = 0; i < __anneau->nbProd; i++) {
+    perf.fabriques += usine.produitsFabriques[i];
+  }
+  perf.duree = rotationFin > rotationDebut ? rotationFin - rotationDebut : 0;
+  perf.cadence = perf.duree > 0 ? perf.fabriques * 1000.0 / perf.duree : 0;
+  perf.delai = usine_delai_moyen(&usine);
+  perf.termine = usine_plan_termine(&usine);
+  
+  return perf;
+}
+
+/**
+ * Affiche le bilan de production de la simulation
+ */
+void bilan(Performances *perf, double duree) {
+  int i, k;
+  
+  printf("==== Bilan de production%s\n", perf->termine ? ": plan terminé" : " (plan inachevé)");
+  printf("====== Politique d'injection: %s\n", usine.politique->nom);
+  
+  // Admission et rôles de chaque anneau
+  for (k = 0; k < nbAnneaux; k++) {
+    usine_anneau(&usine, k);
+    if (nbAnneaux > 1) {
+      printf("====== Anneau %d\n", k);
+    }
+    printf("====== Admission           : %s\n", admission_desc(&usine.admission));
+    printf("====== Rôles               : %s\n", roles_desc(&usine.roles));
+  }
+  usine_anneau(&usine, 0);
+  
+  printf("====== Placement           : %s\n", placement_nom(usine.placement));
+  printf("====== Ports supplémentaires: %s\n", ports_desc(&usine.ports));
+  for (k = 0; k < nbStations; k++) {
+    printf("====== Station %-12s: %d transferts de l'anneau %d, %d de l'anneau %d\n", station_desc(&stations[k]),
+	   stations[k].transferts[0], stations[k].anneaux[0], stations[k].transferts[1], stations[k].anneaux[1]);
+  }
+  printf("====== Composants injectés : %d\n", usine.numeroSerie);
+  printf("====== Produits fabriqués  :");
+  for (i = 0; i < __anneau->nbProd; i++) {
+    printf(" P%d=%d", i + 1, usine.produitsFabriques[i]);
+  }
+  printf("\n");
+  printf("====== Durée de fabrication: %u rotations\n", perf->duree);
+  printf("====== Cadence             : %.2f produits / 1000 rotations\n", perf->cadence);
+  printf("====== Délai moyen         : %.1f rotations\n", perf->delai);
+  printf("====== Simulation: %u rotations en %.3f s", __anneau->generation, duree);
+  if (duree > 0) {
+    printf(", %.0f rotations/s", __anneau->generation / duree);
+  }
+  printf("\n");
+}
+
+/**
+ * Affiche une mesure et son écart à la référence (plus: la hausse est une dégradation)
+ * Retourne 1 si l'écart dépasse la tolérance
+ */
+static int comparer_mesure(const char *nom, double mesure, double reference, bool plus, double tolerance) {
+  double ecart;
+  bool degrade;
+  
+  if (reference <= 0) {
+    printf("====== %-9s: %.2f (pas de référence)\n", nom, mesure);
+    return 0;
+  }
+  
+  ecart = (mesure - reference) * 100 / reference;
+  degrade = plus ? ecart > tolerance : ecart < -tolerance;
+  
+  printf("====== %-9s: %.2f, référence %.2f (%+.1f%%)%s\n", nom, mesure, reference, ecart, degrade ? " RÉGRESSION" : "");
+  return degrade;
+}
+
+/**
+ * Compare les performances à celles du scénario
+ * Retourne le nombre de mesures dégradées au-delà de la tolérance, plus un si le plan
+ * est inachevé sans que le scénario l'attende: les mesures d'une ligne bloquée ne
+ * sont pas comparables à celles d'une ligne qui termine son plan
+ */
+int comparer(Scenario *s, Performances *perf) {
+  int regressions = 0;
+  
+  printf("==== Comparaison aux références (tolérance %.1f%%)\n", s->tolerance);
+  
+  if (!perf->termine) {
+    printf("====== plan     : inachevé%s\n", s->inacheve ? ", attendu (inacheve=1)" : " RÉGRESSION");
+    regressions += !s->inacheve;
+  }
+  
+  // Produits expédiés: aucun écart admis
+  regressions += comparer_mesure("fabriques", perf->fabriques, s->reference.fabriques, false, 0);
+  regressions += comparer_mesure("duree", perf->duree, s->reference.duree, true, s->tolerance);
+  regressions += comparer_mesure("cadence", perf->cadence, s->reference.cadence, false, s->tolerance);
+  regressions += comparer_mesure("delai", perf->delai, s->reference.delai, true, s->tolerance);
+  
+  printf("==== %s\n", regressions ? "ÉCHEC" : "OK");
+  return regressions;
+}
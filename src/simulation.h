@@ -0,0 +1,125 @@
+/*----------------------------------------*/
+/* Simulation de la ligne en un processus */
+/*----------------------------------------*/
+
+#include "common.c"
+#include "journal.c"
+#include "atelier.c"
+
+#include <time.h>
+
+#define SIMULATION_ROTATIONS_MAX	10000000	// Arrêt si le plan n'est pas terminé (option --rotations)
+#define SIMULATION_BLOCAGE		100000		// Arrêt après autant de rotations sans injection ni expédition
+
+#define SCENARIO_ROBOTS_MAX		64	// Nombre de lignes robot= d'un scénario
+#define SCENARIO_LIGNE			128
+#define SCENARIO_TOLERANCE		2.0	// Écart admis par défaut avec les valeurs de référence, en %
+
+/**
+ * Structure Performances: mesures d'une simulation, comparées aux valeurs de référence des scénarios
+ */
+typedef struct {
+  int fabriques;	// Produits expédiés
+  unsigned int duree;	// Rotations de la première injection à la dernière expédition
+  double cadence;	// Produits expédiés pour 1000 rotations
+  double delai;		// Délai moyen en rotations, de l'injection du composant qui complète un produit à son expédition
+  bool termine;		// Plan de production terminé
+} Performances;
+
+/**
+ * Structure Scenario: configuration fixe de la ligne et performances attendues (fichier --scenario=)
+ */
+typedef struct {
+  int nbCases;				// Cases de chaque anneau
+  int nbAnneaux;
+  char stations[SCENARIO_LIGNE];	// Stations de transfert entre les anneaux
+  char ports[SCENARIO_LIGNE];		// Ports supplémentaires du serveur
+  char recettes[SCENARIO_LIGNE];	// Fichier de recettes
+  char injection[SCENARIO_LIGNE];	// Politique d'injection
+  char admission[SCENARIO_LIGNE];	// Règle d'admission
+  char placement[SCENARIO_LIGNE];	// Placement des robots
+  char roles[SCENARIO_LIGNE];		// Pilotage des rôles des robots
+  int nbPlan;			// 0: plan du fichier de recettes
+  int plan[NB_PROD_MAX];
+  int nbRobots;
+  char robots[SCENARIO_ROBOTS_MAX][SCENARIO_LIGNE];
+  char *pRobots[SCENARIO_ROBOTS_MAX];
+  Performances reference;
+  double tolerance;	// En %
+  bool inacheve;	// Plan inachevé attendu: sans cela, un plan inachevé est une régression
+} Scenario;
+
+/**
+ * Global vars: définis dans le fichier common.h
+ * @var pid_t __pid		PID du processus
+ * @var Anneau *__anneau	Anneau courant, alloué dans le tas: ni segment partagé ni sémaphore
+ */
+
+VueAnneau vues[NB_ANNEAUX_MAX]; // Anneaux de la ligne
+int nbAnneaux;
+Station stations[NB_STATIONS_MAX]; // Stations de transfert entre les anneaux
+int nbStations;
+
+Usine usine; // Plan de production et stocks du serveur
+Poste *postes; // Robots, dans l'ordre des abonnements (bot.anneau: anneau, bot.idx: abonnement sur cet anneau)
+int nbPostes;
+
+unsigned int rotationDebut, rotationFin; // Première injection, dernière expédition
+unsigned int rotationActivite; // Dernière injection ou expédition
+
+/**
+ * Robots de install.sh (start_robot_*.sh): id:ops:produits:produits en mode dégradé
+ */
+static char *robotsParDefaut[] = {
+  "1:125:1234:1234",
+  "2:21:12:1234",
+  "3:346:13:1234",
+  "4:43:24:1234",
+  "5:5:13:0",
+  "6:6:24:0"
+};
+
+/**
+ * Construit les nbAnneaux anneaux, branche le serveur à chacun, avec ses ports supplémentaires,
+ * et les robots décrits par robots[] à leur anneau, placés selon placement
+ */
+void init(int nbCases, int nbProd, Produit *recettes, const int *plan, TypePlacement placement, Ports *ports, char **robots);
+
+/**
+ * Lit un plan de production "n1,n2,..." (un nombre par produit)
+ * et retourne le nombre de produits
+ */
+int lire_plan(const char *texte, int *plan);
+
+/**
+ * Charge un fichier de scénario: lignes cle=valeur, # en début de commentaire
+ *   cases=16  recettes=FICHIER  plan=10,15,12,8  injection=POLITIQUE  admission=REGLE  placement=flux  roles=fixes
+ *   anneaux=2  stations=0:8-1:8 (ligne de plusieurs anneaux)  ports=i:8,e:7
+ *   robot=id:ops:produits:produits_dégradés[:anneau] (une ligne par robot)
+ *   fabriques=N  duree=N  cadence=X  delai=X  tolerance=X (valeurs de référence et écart admis en %)
+ *   inacheve=1 (plan inachevé attendu)
+ */
+void lire_scenario(const char *fichier, Scenario *s);
+
+/**
+ * Une rotation de chaque anneau: l'anneau tourne, le serveur puis les robots concernés
+ * la traitent, dans l'ordre fixé par anneau_relayer_rotation() en mode libre; les
+ * stations au départ de l'anneau transfèrent après le serveur, comme transferer()
+ */
+void tourner();
+
+/**
+ * Calcule les performances de la simulation terminée
+ */
+Performances mesurer();
+
+/**
+ * Affiche le bilan de production de la simulation
+ */
+void bilan(Performances *perf, double duree);
+
+/**
+ * Compare les performances à celles du scénario
+ * Retourne le nombre de mesures dégradées au-delà de la tolérance
+ */
+int comparer(Scenario *s, Performances *perf);
@@ -0,0 +1,197 @@
+#include "stat.h"
+
+/**
+ * Global vars: définis dans le fichier common.h
+ * @var Anneau *__anneau		Anneau observé
+ * @var Metriques *__metriques		Compteurs de l'anneau
+ * @var MetriquesRobot *__metriquesRobots	Compteurs de chaque abonnement
+ */
+
+static const char *motifs[NB_REFUS] = { "produit", "regroupe", "stock", "operation", "termine" };
+
+int main(int argc, char *argv[]) {
+  Releve releves[2];
+  struct timespec attente;
+  int intervalle = STAT_INTERVALLE;
+  int nombre = -1; // Relevés à afficher, -1: jusqu'à SIGINT
+  int i, n;
+  
+  argc = lire_option_entier(argc, argv, "--anneau=", &numero);
+  argc = lire_option_chaine(argc, argv, "--robots", &parRobot);
+  argc = lire_option_chaine(argc, argv, "--latences", &latences);
+  
+  if (argc < 2 || argc > 4 || numero < 0 || numero >= NB_ANNEAUX_MAX
+      || (argc > 2 && (intervalle = atoi(argv[2])) < 1) || (argc > 3 && (nombre = atoi(argv[3])) < 1)) {
+    __raise(-1, "Usage: %s <projet> [intervalle en s [nombre de relevés]] [--anneau=0..%d] [--robots] [--latences]", argv[0], NB_ANNEAUX_MAX - 1);
+  }
+  
+  anneau_attacher(argv[1], numero);
+  
+  if (latences != NULL) {
+    latences_afficher(parRobot != NULL);
+    shmdt(__anneau);
+    return 0;
+  }
+  
+  releves[0].robots = malloc(__anneau->nbRobots * sizeof(MetriquesRobot));
+  releves[1].robots = malloc(__anneau->nbRobots * sizeof(MetriquesRobot));
+  
+  //
+  // Signaux bloqués: SIGINT et SIGTERM interrompent l'attente du relevé suivant
+  sigemptyset(&signaux);
+  sigaddset(&signaux, SIGINT);
+  sigaddset(&signaux, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signaux, NULL);
+  
+  attente.tv_sec = intervalle;
+  attente.tv_nsec = 0;
+  
+  //
+  // Un relevé par intervalle: taux depuis le précédent, comme vmstat
+  relever(&releves[0]);
+  
+  for (i = 0; nombre < 0 || i < nombre; i++) {
+    if (sigtimedwait(&signaux, NULL, &attente) > 0) {
+      break;
+    }
+    n = (i + 1) % 2;
+    relever(&releves[n]);
+  
+    if (i % STAT_ENTETE == 0 || parRobot != NULL) {
+      entete();
+    }
+    afficher(&releves[1 - n], &releves[n]);
+  
+    if (parRobot != NULL) {
+      afficher_robots(&releves[1 - n], &releves[n]);
+    }
+  }
+  
+  relever(&releves[0]);
+  bilan(&releves[0]);
+  
+  free(releves[0].robots);
+  free(releves[1].robots);
+  shmdt(__anneau);
+  return 0;
+}
+
+/**
+ * Copie les compteurs de l'anneau dans r
+ * Chaque compteur est lu atomiquement; le relevé n'est pas une image cohérente de
+ * tout le bloc, l'écart se limite aux incréments de la rotation en cours
+ */
+void relever(Releve *r) {
+  static int i, k;
+  
+  clock_gettime(CLOCK_MONOTONIC, &r->date);
+  r->generation = __atomic_load_n(&__anneau->generation, __ATOMIC_RELAXED);
+  r->anneau.depassements = __atomic_load_n(&__metriques->depassements, __ATOMIC_RELAXED);
+  r->anneau.manqueesServeur = __atomic_load_n(&__metriques->manqueesServeur, __ATOMIC_RELAXED);
+  
+  for (k = 0; k < 3; k++) {
+    r->anneau.cases[k] = __atomic_load_n(&__metriques->cases[k], __ATOMIC_RELAXED);
+  }
+  for (k = 0; k < __anneau->nbProd; k++) {
+    r->anneau.injections[k] = __atomic_load_n(&__metriques->injections[k], __ATOMIC_RELAXED);
+    r->anneau.expeditions[k] = __atomic_load_n(&__metriques->expeditions[k], __ATOMIC_RELAXED);
+    r->anneau.rotationsExpedies[k] = __atomic_load_n(&__metriques->rotationsExpedies[k], __ATOMIC_RELAXED);
+  }
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    r->robots[i].occupe = __atomic_load_n(&__metriquesRobots[i].occupe, __ATOMIC_RELAXED);
+    r->robots[i].bloque = __atomic_load_n(&__metriquesRobots[i].bloque, __ATOMIC_RELAXED);
+    r->robots[i].inactif = __atomic_load_n(&__metriquesRobots[i].inactif, __ATOMIC_RELAXED);
+    r->robots[i].manquees = __atomic_load_n(&__metriquesRobots[i].manquees, __ATOMIC_RELAXED);
+    for (k = 0; k < NB_REFUS; k++) {
+      r->robots[i].refus[k] = __atomic_load_n(&__metriquesRobots[i].refus[k], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+/**
+ * Affiche l'en-tête des colonnes
+ */
+void entete() {
+  printf("%9s %7s %7s %5s %5s %5s %7s %7s %7s %7s %9s\n",
+	 "rot/s", "inj/s", "exp/s", "vide", "comp", "prod", "occupe", "bloque", "inactif", "refus/s", "periode");
+}
+
+/**
+ * Affiche les taux entre les relevés a et b, puis l'occupation relevée en b
+ * occupe, bloque et inactif: part des rotations de tous les robots connectés, en %
+ * periode: période courante de l'anneau (cadence adaptative), 0 en mode libre
+ */
+void afficher(Releve *a, Releve *b) {
+  static double duree;
+  static unsigned long injections, expeditions, occupe, bloque, inactif, refus, total;
+  static int i, k;
+  
+  duree = (b->date.tv_sec - a->date.tv_sec) + (b->date.tv_nsec - a->date.tv_nsec) / 1e9;
+  
+  injections = expeditions = 0;
+  for (k = 0; k < __anneau->nbProd; k++) {
+    injections += b->anneau.injections[k] - a->anneau.injections[k];
+    expeditions += b->anneau.expeditions[k] - a->anneau.expeditions[k];
+  }
+  
+  occupe = bloque = inactif = refus = 0;
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    occupe += b->robots[i].occupe - a->robots[i].occupe;
+    bloque += b->robots[i].bloque - a->robots[i].bloque;
+    inactif += b->robots[i].inactif - a->robots[i].inactif;
+    for (k = 0; k < NB_REFUS; k++) {
+      refus += b->robots[i].refus[k] - a->robots[i].refus[k];
+    }
+  }
+  total = occupe + bloque + inactif;
+  
+  printf("%9.1f %7.1f %7.1f %4ld%% %4ld%% %4ld%% %6.1f%% %6.1f%% %6.1f%% %7.1f %7.0fus\n",
+	 (b->generation - a->generation) / duree, injections / duree, expeditions / duree,
+	 b->anneau.cases[VIDE] * 100 / __anneau->nbCases,
+	 b->anneau.cases[COMPOSANT] * 100 / __anneau->nbCases,
+	 b->anneau.cases[PRODUIT] * 100 / __anneau->nbCases,
+	 total ? occupe * 100.0 / total : 0, total ? bloque * 100.0 / total : 0, total ? inactif * 100.0 / total : 0,
+	 refus / duree, __anneau->libre ? 0 : __atomic_load_n(&__anneau->periode, __ATOMIC_RELAXED) / 1e3);
+}
+
+/**
+ * Affiche les compteurs de chaque robot connecté entre les relevés a et b
+ */
+void afficher_robots(Releve *a, Releve *b) {
+  static unsigned long occupe, bloque, inactif, total;
+  static int i, k;
+  
+  for (i = 0; i < __anneau->nbRobots; i++) {
+    if (__abonnes[i].pid == 0) {
+      continue;
+    }
+    occupe = b->robots[i].occupe - a->robots[i].occupe;
+    bloque = b->robots[i].bloque - a->robots[i].bloque;
+    inactif = b->robots[i].inactif - a->robots[i].inactif;
+    total = occupe + bloque + inactif;
+  
+    printf("    R%-3d pos %3d  occupe %5.1f%%  bloque %5.1f%%  inactif %5.1f%%  refus", __abonnes[i].id, __abonnes[i].pos,
+	   total ? occupe * 100.0 / total : 0, total ? bloque * 100.0 / total : 0, total ? inactif * 100.0 / total : 0);
+    for (k = 0; k < NB_REFUS; k++) {
+      printf(" %s=%lu", motifs[k], b->robots[i].refus[k] - a->robots[i].refus[k]);
+    }
+    printf("  manquees=%lu\n", b->robots[i].manquees - a->robots[i].manquees);
+  }
+}
+
+/**
+ * Affiche les totaux depuis le démarrage de l'anneau: injections, expéditions et tours par produit
+ * Tours: rotations moyennes d'un produit expédié depuis l'injection de son dernier composant, en tours d'anneau
+ */
+void bilan(Releve *r) {
+  static int k;
+  
+  printf("==== Anneau %d, rotation %u, dépassements %lu, rotations manquées par le serveur %lu\n", __anneau->numero, r->generation,
+	 r->anneau.depassements, r->anneau.manqueesServeur);
+  
+  for (k = 0; k < __anneau->nbProd; k++) {
+    printf("====== P%-2d injectés %6lu  expédiés %6lu  tours %6.2f\n", k + 1, r->anneau.injections[k], r->anneau.expeditions[k],
+	   r->anneau.expeditions[k] ? (double) r->anneau.rotationsExpedies[k] / r->anneau.expeditions[k] / __anneau->nbCases : 0);
+  }
+}
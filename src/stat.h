@@ -0,0 +1,58 @@
+/*--------------------------------------*/
+/* Relevé des compteurs d'un anneau     */
+/*--------------------------------------*/
+
+#include "common.c"
+
+#include <time.h>
+
+#define STAT_INTERVALLE		1	// Secondes entre deux relevés par défaut
+#define STAT_ENTETE		20	// Relevés entre deux rappels de l'en-tête
+
+/**
+ * Global vars: définis dans le fichier common.h
+ * @var Anneau *__anneau		Anneau observé: les compteurs se lisent sans prendre le sémaphore
+ * @var Metriques *__metriques		Compteurs de l'anneau
+ * @var MetriquesRobot *__metriquesRobots	Compteurs de chaque abonnement
+ */
+
+/**
+ * Structure Releve: copie des compteurs à un instant
+ */
+typedef struct {
+  struct timespec date;
+  unsigned int generation;
+  Metriques anneau;
+  MetriquesRobot *robots;	// [nbRobots]
+} Releve;
+
+static int numero = 0; // Anneau observé (--anneau)
+static char *parRobot = NULL; // --robots: une ligne par robot à chaque relevé
+static char *latences = NULL; // --latences: centiles des histogrammes de latence, sans relevés
+
+sigset_t signaux; // SIGINT et SIGTERM: fin des relevés
+
+/**
+ * Copie les compteurs de l'anneau dans r
+ */
+void relever(Releve *r);
+
+/**
+ * Affiche l'en-tête des colonnes
+ */
+void entete();
+
+/**
+ * Affiche les taux entre les relevés a et b, puis l'occupation relevée en b
+ */
+void afficher(Releve *a, Releve *b);
+
+/**
+ * Affiche les compteurs de chaque robot connecté entre les relevés a et b
+ */
+void afficher_robots(Releve *a, Releve *b);
+
+/**
+ * Affiche les totaux depuis le démarrage de l'anneau: injections, expéditions et tours par produit
+ */
+void bilan(Releve *r);